@@ -4,62 +4,62 @@
 // Macro to extract 6-bit chunks from the 48-bit input
 #define divide_input(__INPUT__,__POS__) (uint8_t)((__INPUT__ >> ((8 - __POS__) * 6)) & 0x3F)
 
-int S1[4][16] = {
+constexpr int S1[4][16] = {
     {14, 4, 13, 1, 2, 15, 11, 8, 3, 10, 6, 12, 5, 9, 0, 7},
     {0, 15, 7, 4, 14, 2, 13, 1, 10, 6, 12, 11, 9, 5, 3, 8},
     {4, 1, 14, 8, 13, 6, 2, 11, 15, 12, 9, 7, 3, 10, 5, 0},
     {15, 12, 8, 2, 4, 9, 1, 7, 5, 11, 3, 14, 10, 0, 6, 13}
 };
 
-int S2[4][16] = {
+constexpr int S2[4][16] = {
     {15, 1, 8, 14, 6, 11, 3, 4, 9, 7, 2, 13, 12, 0, 5, 10},
     {3, 13, 4, 7, 15, 2, 8, 14, 12, 0, 1, 10, 6, 9, 11, 5},
     {0, 14, 7, 11, 10, 4, 13, 1, 5, 8, 12, 6, 9, 3, 2, 15},
     {13, 8, 10, 1, 3, 15, 4, 2, 11, 6, 7, 12, 0, 5, 14, 9}
 };
 
-int S3[4][16] = {
+constexpr int S3[4][16] = {
     {10, 0, 9, 14, 6, 3, 15, 5, 1, 13, 12, 7, 11, 4, 2, 8},
     {13, 7, 0, 9, 3, 4, 6, 10, 2, 8, 5, 14, 12, 11, 15, 1},
     {13, 6, 4, 9, 8, 15, 3, 0, 11, 1, 2, 12, 5, 10, 14, 7},
     {1, 10, 13, 0, 6, 9, 8, 7, 4, 15, 14, 3, 11, 5, 2, 12}
 };
 
-int S4[4][16] = {
+constexpr int S4[4][16] = {
     {7, 13, 14, 3, 0, 6, 9, 10, 1, 2, 8, 5, 11, 12, 4, 15},
     {13, 8, 11, 5, 6, 15, 0, 3, 4, 7, 2, 12, 1, 10, 14, 9},
     {10, 6, 9, 0, 12, 11, 7, 13, 15, 1, 3, 14, 5, 2, 8, 4},
     {3, 15, 0, 6, 10, 1, 13, 8, 9, 4, 5, 11, 12, 7, 2, 14}
 };
 
-int S5[4][16] = {
+constexpr int S5[4][16] = {
     {2, 12, 4, 1, 7, 10, 11, 6, 8, 5, 3, 15, 13, 0, 14, 9},
     {14, 11, 2, 12, 4, 7, 13, 1, 5, 0, 15, 10, 3, 9, 8, 6},
     {4, 2, 1, 11, 10, 13, 7, 8, 15, 9, 12, 5, 6, 3, 0, 14},
     {11, 8, 12, 7, 1, 14, 2, 13, 6, 15, 0, 9, 10, 4, 5, 3}
 };
 
-int S6[4][16] = {
+constexpr int S6[4][16] = {
     {12, 1, 10, 15, 9, 2, 6, 8, 0, 13, 3, 4, 14, 7, 5, 11},
     {10, 15, 4, 2, 7, 12, 9, 5, 6, 1, 13, 14, 0, 11, 3, 8},
     {9, 14, 15, 5, 2, 8, 12, 3, 7, 0, 4, 10, 1, 13, 11, 6},
     {4, 3, 2, 12, 9, 5, 15, 10, 11, 14, 1, 7, 6, 0, 8, 13}
 };
 
-int S7[4][16] = {
+constexpr int S7[4][16] = {
     {4, 11, 2, 14, 15, 0, 8, 13, 3, 12, 9, 7, 5, 10, 6, 1},
     {13, 0, 11, 7, 4, 9, 1, 10, 14, 3, 5, 12, 2, 15, 8, 6},
     {1, 4, 11, 13, 12, 3, 7, 14, 10, 15, 6, 8, 0, 5, 9, 2},
     {6, 11, 13, 8, 1, 4, 10, 7, 9, 5, 0, 15, 14, 2, 3, 12}
 };
 
-int S8[4][16] = {
+constexpr int S8[4][16] = {
     {13, 2, 8, 4, 6, 15, 11, 1, 10, 9, 3, 14, 5, 0, 12, 7},
     {1, 15, 13, 8, 10, 3, 7, 4, 12, 5, 6, 11, 0, 14, 9, 2},
     {7, 11, 4, 1, 9, 12, 14, 2, 0, 6, 10, 13, 15, 3, 5, 8},
     {2, 1, 14, 7, 4, 10, 8, 13, 15, 12, 9, 0, 3, 5, 6, 11}
 };
-uint8_t SBox_n(uint8_t input_data, int sbox[4][16])
+static uint8_t SBox_n(uint8_t input_data, const int sbox[4][16])
 {
     // Extract the row from the first and last bits
     uint8_t row = ((input_data & 0x20) >> 4) | (input_data & 0x01);
@@ -73,7 +73,7 @@ uint8_t SBox_n(uint8_t input_data, int sbox[4][16])
     return s_n;
 }
 
-uint32_t SBox(uint64_t input_data)
+[[maybe_unused]] static uint32_t SBox(uint64_t input_data)
 {
     // Extract 6-bit chunks for each S-box from the 48-bit input
     uint8_t s1 = SBox_n(divide_input(input_data, 1), S1);
@@ -92,6 +92,49 @@ uint32_t SBox(uint64_t input_data)
     return output_data;
 }
 
+// S-boxes in DES order, used to build the SP tables
+constexpr const int (*SBoxes[8])[16] = {S1, S2, S3, S4, S5, S6, S7, S8};
+
+// Fused S-box + P tables: SP[n][x] is the output of S-box n+1 for the 6-bit input x, already moved
+// to its position after the P permutation. 8 x 64 x 4 bytes = 2 KiB, aligned to cache lines.
+alignas(64) static uint32_t SP[8][64];
+
+/**
+ * @brief Build the fused SP tables from the S-boxes and the P permutation table.
+ *
+ * @param p_table The 32-bit P permutation table (1-based, MSB first).
+ */
+static void buildSPTables(const int* p_table)
+{
+    for (int n = 0; n < 8; n++) {
+        for (int x = 0; x < 64; x++) {
+            // S-box output at its place in the 32-bit SBox() result
+            uint32_t s_out = (uint32_t)SBox_n(x, SBoxes[n]) << (28 - 4 * n);
+
+            // apply P to it
+            uint32_t sp = 0;
+            for (int i = 0; i < 32; i++) {
+                sp |= ((s_out >> (32 - p_table[i])) & 0x01) << (31 - i);
+            }
+            SP[n][x] = sp;
+        }
+    }
+}
+
+/**
+ * @brief S-boxes followed by the P permutation, using the fused SP tables.
+ *
+ * @param input_data 48-bit input (expanded right half XOR subkey).
+ * @return 32-bit output, equal to permute(SBox(input_data), P, 32, 32).
+ */
+static inline uint32_t SPBox(uint64_t input_data)
+{
+    return SP[0][divide_input(input_data, 1)] | SP[1][divide_input(input_data, 2)]
+         | SP[2][divide_input(input_data, 3)] | SP[3][divide_input(input_data, 4)]
+         | SP[4][divide_input(input_data, 5)] | SP[5][divide_input(input_data, 6)]
+         | SP[6][divide_input(input_data, 7)] | SP[7][divide_input(input_data, 8)];
+}
+
 /* for Testing The SBox module
 
 int main(void)
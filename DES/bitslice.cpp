@@ -0,0 +1,479 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <immintrin.h>
+
+#include <type_traits>
+#include <utility>
+
+// Bitsliced DES engine.
+//
+// A batch of blocks is transposed into 64 bit-planes: plane p holds bit p (MSB first, DES bit p+1)
+// of every block, one block per bit lane. The permutations become wire renamings between planes,
+// the S-boxes are evaluated as Boolean circuits and no memory lookup depends on the data, so the
+// engine runs in constant time. The plane type T is uint64_t (64 blocks per pass) or a SIMD vector
+// (__m256i, __m512i) holding 64 blocks per 64-bit lane.
+//
+// The key schedule only moves bits too: with one key per lane, the keys are transposed into 64 key
+// planes and every round key plane is one of them, so each block can use its own key at no cost.
+//
+// The blocks are transposed as stored in the files. On a little-endian host a byte swap moves bit p
+// of the big-endian block to bit p ^ 56, so it is folded into the renamings of IP and FP and costs
+// no instruction.
+//
+// Uses the DES tables and the S-boxes, so it is included after their definitions.
+
+#define bs_inline inline __attribute__((always_inline))
+
+// the generic templates take and fill the planes by reference: a SIMD plane returned by value from a
+// function without the matching instruction set would change its ABI (-Wpsabi), even once inlined
+
+// plane of the transposed file words holding plane p of the big-endian blocks is p ^ bs_byte_swap
+constexpr int bs_byte_swap = host_little_endian ? 56 : 0;
+
+/**
+ * @brief Transpose a 64x64 bit matrix in place (row i, bit 63-j) <-> (row j, bit 63-i).
+ *
+ * @param a Array of 64 64-bit rows.
+ *
+ * Turns 64 blocks into 64 bit-planes and back, as the transposition is its own inverse.
+ */
+static void transpose64(uint64_t a[64]) {
+    uint64_t m = 0x00000000FFFFFFFFULL;
+    for (int j = 32; j != 0; j >>= 1, m ^= (m << j)) {
+        for (int k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+            uint64_t t = (a[k] ^ (a[k | j] >> j)) & m;
+            a[k] ^= t;
+            a[k | j] ^= (t << j);
+        }
+    }
+}
+
+/**
+ * @brief Truth table of one output bit of an S-box.
+ *
+ * @param n S-box index (0 to 7).
+ * @param k Output bit (0 is the most significant of the 4 bits).
+ * @return 64-bit word whose bit x is output bit k of S-box n+1 for the 6-bit input x.
+ */
+static constexpr uint64_t sboxTruthTable(int n, int k) {
+    uint64_t tt = 0;
+    for (int x = 0; x < 64; x++) {
+        int row = ((x & 0x20) >> 4) | (x & 0x01);
+        int col = (x >> 1) & 0x0F;
+        tt |= (uint64_t)((SBoxes[n][row][col] >> (3 - k)) & 0x01) << x;
+    }
+    return tt;
+}
+
+/**
+ * @brief Slice of an S-box truth table once the first `level` input bits are fixed to `prefix`.
+ */
+static constexpr uint64_t sboxSlice(int n, int k, int level, int prefix) {
+    int width = 1 << (6 - level);
+    uint64_t mask = (width == 64) ? ~0ULL : ((1ULL << width) - 1);
+    return (sboxTruthTable(n, k) >> (prefix * width)) & mask;
+}
+
+/**
+ * @brief Boolean function of the last two S-box input bits (b5, b6) given by its 4-bit truth table.
+ *
+ * Bit (2 * b5 + b6) of TT is the function value. Each of the 16 functions costs at most 2 gates.
+ */
+template <int TT, typename T>
+static bs_inline void sboxLeaf(T& out, const T& b5, const T& b6) {
+    if constexpr (TT == 0x0) out = T{};
+    else if constexpr (TT == 0xF) out = ~T{};
+    else if constexpr (TT == 0xC) out = b5;
+    else if constexpr (TT == 0x3) out = ~b5;
+    else if constexpr (TT == 0xA) out = b6;
+    else if constexpr (TT == 0x5) out = ~b6;
+    else if constexpr (TT == 0x8) out = b5 & b6;
+    else if constexpr (TT == 0x7) out = ~(b5 & b6);
+    else if constexpr (TT == 0x6) out = b5 ^ b6;
+    else if constexpr (TT == 0x9) out = ~(b5 ^ b6);
+    else if constexpr (TT == 0xE) out = b5 | b6;
+    else if constexpr (TT == 0x1) out = ~(b5 | b6);
+    else if constexpr (TT == 0x4) out = b5 & ~b6;
+    else if constexpr (TT == 0xB) out = ~b5 | b6;
+    else if constexpr (TT == 0x2) out = ~b5 & b6;
+    else out = b5 | ~b6;  // 0xD
+}
+
+/**
+ * @brief Circuit of one S-box output bit: a multiplexer tree on b1..b4 over functions of (b5, b6).
+ *
+ * Subtrees are resolved at compile time from the truth table, identical halves skip the
+ * multiplexer and complementary halves reduce it to a single XOR.
+ *
+ * @param out The output bit-plane.
+ * @param b The 6 input bit-planes of the S-box, b[0] is the most significant.
+ */
+template <int N, int K, int Level, int Prefix, typename T>
+static bs_inline void sboxCircuit(T& out, const T b[6]) {
+    if constexpr (Level == 4) {
+        sboxLeaf<(int)sboxSlice(N, K, 4, Prefix)>(out, b[4], b[5]);
+    } else {
+        constexpr uint64_t lo_tt = sboxSlice(N, K, Level + 1, 2 * Prefix);
+        constexpr uint64_t hi_tt = sboxSlice(N, K, Level + 1, 2 * Prefix + 1);
+        constexpr uint64_t width_mask = (1ULL << (1 << (5 - Level))) - 1;
+
+        T lo;
+        sboxCircuit<N, K, Level + 1, 2 * Prefix>(lo, b);
+        if constexpr (lo_tt == hi_tt) {
+            out = lo;
+        } else if constexpr (lo_tt == (~hi_tt & width_mask)) {
+            out = lo ^ b[Level];
+        } else {
+            T hi;
+            sboxCircuit<N, K, Level + 1, 2 * Prefix + 1>(hi, b);
+            out = lo ^ ((lo ^ hi) & b[Level]);
+        }
+    }
+}
+
+// inverse of the P permutation: S-box output bit i lands on bit P_inv[i] of the round output
+struct PInverse {
+    int v[32];
+    constexpr PInverse() : v() {
+        for (int i = 0; i < 32; i++) v[P[i] - 1] = i;
+    }
+};
+constexpr PInverse P_inv;
+
+/**
+ * @brief One S-box of a bitsliced round: L ^= P(S_n(E(R) ^ K)) restricted to S-box N.
+ *
+ * @param L Left half planes, updated in place.
+ * @param R Right half planes.
+ * @param K The 48 round key planes.
+ */
+template <int N, typename T>
+static bs_inline void bitsliceSBox(T* L, const T* R, const T* K) {
+    T b[6];
+    for (int j = 0; j < 6; j++) {
+        b[j] = R[E_t[6 * N + j] - 1] ^ K[6 * N + j];
+    }
+    T out;
+    sboxCircuit<N, 0, 0, 0>(out, b);
+    L[P_inv.v[4 * N + 0]] ^= out;
+    sboxCircuit<N, 1, 0, 0>(out, b);
+    L[P_inv.v[4 * N + 1]] ^= out;
+    sboxCircuit<N, 2, 0, 0>(out, b);
+    L[P_inv.v[4 * N + 2]] ^= out;
+    sboxCircuit<N, 3, 0, 0>(out, b);
+    L[P_inv.v[4 * N + 3]] ^= out;
+}
+
+template <typename T, size_t... N>
+static bs_inline void bitsliceRound(T* L, const T* R, const T* K, std::index_sequence<N...>) {
+    (bitsliceSBox<N>(L, R, K), ...);
+}
+
+/**
+ * @brief Round key planes of a single key schedule, every lane uses the same key.
+ *
+ * masks[i][j] is all ones if bit j (MSB first) of the 48-bit subkey i is set, zero otherwise.
+ * Triple DES chains 3 stages of 16 rounds.
+ */
+struct BitsliceKeys {
+    int stages;
+    uint64_t masks[48][48];
+};
+
+/**
+ * @brief Expand 16 subkeys per stage into bitsliced round key masks.
+ *
+ * @param bs_keys The masks to fill.
+ * @param keys Array of 16 * stages 48-bit subkeys, in the order they are applied.
+ * @param stages 1 for DES, 3 for triple DES.
+ */
+static void buildBitsliceKeys(BitsliceKeys& bs_keys, const uint64_t* keys, int stages = 1) {
+    bs_keys.stages = stages;
+    for (int i = 0; i < 16 * stages; i++) {
+        for (int j = 0; j < 48; j++) {
+            bs_keys.masks[i][j] = 0 - ((keys[i] >> (47 - j)) & 0x01);
+        }
+    }
+}
+
+/**
+ * @brief Bit of the key that becomes each bit of the 16 subkeys.
+ *
+ * v[i][j] is the key bit (MSB first, DES bit v[i][j] + 1) that PC-1, the rotations of round i and PC-2
+ * move to bit j (MSB first) of subkey i, so round key plane j of round i is key plane v[i][j].
+ */
+struct KeyBitSchedule {
+    int v[16][48];
+    constexpr KeyBitSchedule() : v() {
+        int shift = 0;
+        for (int i = 0; i < 16; i++) {
+            shift += left_shift_table[i];
+            for (int j = 0; j < 48; j++) {
+                // bit of C (0 to 27) or D (28 to 55) after the rotations, then before them
+                int rotated = pc_2[j] - 1;
+                int half = rotated / 28 * 28;
+                v[i][j] = pc_1[half + (rotated - half + shift) % 28] - 1;
+            }
+        }
+    }
+};
+constexpr KeyBitSchedule key_bits;
+
+/**
+ * @brief Subkey bits that each key bit becomes, the inverse of key_bits.
+ *
+ * v[p][i] has bit 47 - j set for every bit j of subkey i taken from key bit p (MSB first), so flipping key
+ * bit p flips subkey i by v[p][i]. The parity bits become no subkey bit.
+ */
+struct SubkeyBitMasks {
+    uint64_t v[64][16];
+    constexpr SubkeyBitMasks() : v() {
+        for (int i = 0; i < 16; i++) {
+            for (int j = 0; j < 48; j++) {
+                v[key_bits.v[i][j]][i] |= uint64_t(1) << (47 - j);
+            }
+        }
+    }
+};
+constexpr SubkeyBitMasks subkey_bit_masks;
+
+/**
+ * @brief Broadcast a 64-bit mask to every lane of a plane.
+ */
+template <typename T>
+static bs_inline void bsSplat(T& plane, uint64_t mask) {
+    if constexpr (std::is_integral<T>::value) {
+        plane = mask;
+    } else {
+        plane = T{} ^ (long long)mask;
+    }
+}
+
+// round key planes of a single key schedule, the masks broadcast to every lane
+struct SplatRoundKeys {
+    const BitsliceKeys& bs_keys;
+
+    template <typename T>
+    bs_inline void load(int i, T* K) const {
+        for (int j = 0; j < 48; j++) bsSplat(K[j], bs_keys.masks[i][j]);
+    }
+};
+
+// round key planes of one DES key per lane, renamed from the key planes
+template <typename T>
+struct LaneRoundKeys {
+    const T* key_planes;
+    bool decrypt;  // the subkeys are applied in reverse order
+
+    bs_inline void load(int i, T* K) const {
+        const int* bits = key_bits.v[decrypt ? 15 - i : i];
+        for (int j = 0; j < 48; j++) K[j] = key_planes[bits[j]];
+    }
+};
+
+/**
+ * @brief The 16 DES rounds on bit-planes, between IP and FP, or the 48 rounds of triple DES.
+ *
+ * @param planes 64 bit-planes of the blocks as stored in the files, replaced by the 64 output planes.
+ * @param stages 1 for DES, 3 for triple DES.
+ * @param round_keys Source of the round key planes, round_keys.load(i, K) fills the 48 planes of round i.
+ *
+ * The FP and IP between two stages of triple DES cancel out and leave the halves swapped, so the
+ * stages are chained by swapping the roles of the half planes.
+ */
+template <typename T, typename RoundKeys>
+static bs_inline void DES_bitslice_planes(T* planes, int stages, const RoundKeys& round_keys) {
+    // initial permutation, a renaming of the planes
+    T L[32], R[32];
+    for (int i = 0; i < 32; i++) {
+        L[i] = planes[(IP_t[i] - 1) ^ bs_byte_swap];
+        R[i] = planes[(IP_t[32 + i] - 1) ^ bs_byte_swap];
+    }
+
+    // perform 16 rounds per stage, two at a time so that the halves swap roles instead of being copied
+    T K[48];
+    T* A = L;
+    T* B = R;
+    for (int s = 0; s < stages; s++) {
+        if (s > 0) std::swap(A, B);
+
+        for (int i = 16 * s; i < 16 * s + 16; i += 2) {
+            round_keys.load(i, K);
+            bitsliceRound(A, B, K, std::make_index_sequence<8>());
+
+            round_keys.load(i + 1, K);
+            bitsliceRound(B, A, K, std::make_index_sequence<8>());
+        }
+    }
+
+    // final permutation of R16 L16, again a renaming
+    for (int i = 0; i < 64; i++) {
+        int src = P_1[i] - 1;
+        planes[i ^ bs_byte_swap] = (src < 32) ? B[src] : A[src - 32];
+    }
+}
+
+/**
+ * @brief Transpose 64 * (sizeof(T) / 8) 64-bit rows into 64 planes, lane w of the planes holds rows
+ * [64 * w, 64 * w + 64). Plane p holds bit p (MSB first) of the rows.
+ */
+template <typename T>
+static bs_inline void bsTransposeIn(const uint64_t* rows_in, T* planes) {
+    constexpr int lanes = sizeof(T) / 8;
+
+    alignas(64) uint64_t words[64][lanes];  // words[p][w]: plane p of lane w
+    uint64_t rows[64];
+    for (int w = 0; w < lanes; w++) {
+        memcpy(rows, rows_in + 64 * w, sizeof(rows));
+        transpose64(rows);
+        for (int p = 0; p < 64; p++) words[p][w] = rows[p];
+    }
+    memcpy(planes, words, sizeof(words));
+}
+
+/**
+ * @brief Transpose 64 planes back into 64 * (sizeof(T) / 8) rows, the inverse of bsTransposeIn().
+ */
+template <typename T>
+static bs_inline void bsTransposeOut(const T* planes, uint64_t* rows_out) {
+    constexpr int lanes = sizeof(T) / 8;
+
+    alignas(64) uint64_t words[64][lanes];
+    uint64_t rows[64];
+    memcpy(words, planes, sizeof(words));
+    for (int w = 0; w < lanes; w++) {
+        for (int p = 0; p < 64; p++) rows[p] = words[p][w];
+        transpose64(rows);
+        memcpy(rows_out + 64 * w, rows, sizeof(rows));
+    }
+}
+
+/**
+ * @brief Encrypt or decrypt 64 * (sizeof(T) / 8) blocks in place with the bitsliced engine.
+ *
+ * @param blocks Blocks to process, as stored in the files (big-endian).
+ * @param bs_keys Round key masks, in the order they are applied.
+ *
+ * Lane w of the plane type holds blocks [64 * w, 64 * w + 64).
+ */
+template <typename T>
+static bs_inline void DES_bitslice(uint64_t* blocks, const BitsliceKeys& bs_keys) {
+    T planes[64];
+    bsTransposeIn(blocks, planes);
+    DES_bitslice_planes(planes, bs_keys.stages, SplatRoundKeys{bs_keys});
+    bsTransposeOut(planes, blocks);
+}
+
+/**
+ * @brief Encrypt or decrypt 64 * (sizeof(T) / 8) blocks in place, each with its own DES key.
+ *
+ * @param blocks Blocks to process, as stored in the files (big-endian).
+ * @param keys One 64-bit key per block, as values (DES bit 1 is the most significant bit).
+ * @param decrypt true to decrypt, false to encrypt.
+ */
+template <typename T>
+static bs_inline void DES_bitslice_keys(uint64_t* blocks, const uint64_t* keys, bool decrypt) {
+    T planes[64], key_planes[64];
+    bsTransposeIn(blocks, planes);
+    bsTransposeIn(keys, key_planes);
+    DES_bitslice_planes(planes, 1, LaneRoundKeys<T>{key_planes, decrypt});
+    bsTransposeOut(planes, blocks);
+}
+
+/**
+ * @brief Portable 64-block bitsliced DES.
+ *
+ * @param blocks 64 blocks, processed in place.
+ * @param bs_keys Round key masks, in the order they are applied.
+ */
+static void DES_bitslice64(uint64_t* blocks, const BitsliceKeys& bs_keys) {
+    DES_bitslice<uint64_t>(blocks, bs_keys);
+}
+
+/**
+ * @brief Portable 64-block bitsliced DES with one DES key per block.
+ */
+static void DES_bitslice64_keys(uint64_t* blocks, const uint64_t* keys, bool decrypt) {
+    DES_bitslice_keys<uint64_t>(blocks, keys, decrypt);
+}
+
+/**
+ * @brief AVX2 256-block bitsliced DES on __m256i planes.
+ */
+static __attribute__((target("avx2"), flatten))
+void DES_bitslice256(uint64_t* blocks, const BitsliceKeys& bs_keys) {
+    DES_bitslice<__m256i>(blocks, bs_keys);
+}
+
+/**
+ * @brief AVX2 256-block bitsliced DES with one DES key per block.
+ */
+static __attribute__((target("avx2"), flatten))
+void DES_bitslice256_keys(uint64_t* blocks, const uint64_t* keys, bool decrypt) {
+    DES_bitslice_keys<__m256i>(blocks, keys, decrypt);
+}
+
+/**
+ * @brief AVX-512 512-block bitsliced DES on __m512i planes.
+ */
+static __attribute__((target("avx512f"), flatten))
+void DES_bitslice512(uint64_t* blocks, const BitsliceKeys& bs_keys) {
+    DES_bitslice<__m512i>(blocks, bs_keys);
+}
+
+/**
+ * @brief AVX-512 512-block bitsliced DES with one DES key per block.
+ */
+static __attribute__((target("avx512f"), flatten))
+void DES_bitslice512_keys(uint64_t* blocks, const uint64_t* keys, bool decrypt) {
+    DES_bitslice_keys<__m512i>(blocks, keys, decrypt);
+}
+
+/**
+ * @brief A bitsliced kernel and the number of blocks it processes per call.
+ */
+struct BitsliceKernel {
+    const char* name;
+    size_t blocks;
+    void (*run)(uint64_t* blocks, const BitsliceKeys& bs_keys);
+    void (*run_keys)(uint64_t* blocks, const uint64_t* keys, bool decrypt);  // one DES key per block
+};
+
+// available kernels, widest first
+const BitsliceKernel bitslice_kernels[] = {
+    {"avx512", 512, DES_bitslice512, DES_bitslice512_keys},
+    {"avx2", 256, DES_bitslice256, DES_bitslice256_keys},
+    {"portable", 64, DES_bitslice64, DES_bitslice64_keys},
+};
+
+/**
+ * @brief Check if the host CPU can run a kernel.
+ *
+ * @param kernel The kernel to check.
+ * @return true if the CPU (and the OS) support the instruction set of the kernel, false otherwise.
+ */
+static bool bitsliceKernelSupported(const BitsliceKernel& kernel) {
+    __builtin_cpu_init();
+    if (kernel.blocks == 512) return __builtin_cpu_supports("avx512f");
+    if (kernel.blocks == 256) return __builtin_cpu_supports("avx2");
+    return true;
+}
+
+/**
+ * @brief Select the bitsliced kernel to use.
+ *
+ * @param name Name of the kernel to force, "auto" or nullptr to pick the widest one the host supports.
+ * @return The selected kernel, nullptr if the name is unknown or the host does not support it.
+ */
+static const BitsliceKernel* selectBitsliceKernel(const char* name) {
+    bool pick_widest = (name == nullptr) || (strcmp(name, "auto") == 0);
+    for (const BitsliceKernel& kernel : bitslice_kernels) {
+        if (pick_widest) {
+            if (bitsliceKernelSupported(kernel)) return &kernel;
+        } else if (strcmp(name, kernel.name) == 0) {
+            return bitsliceKernelSupported(kernel) ? &kernel : nullptr;
+        }
+    }
+    return nullptr;
+}
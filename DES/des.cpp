@@ -0,0 +1,910 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+#include "des.h"
+
+// DES engine: tables, key schedule, kernels and modes of operation, without any global state but the
+// tables built once by initPermutationTables(). Built as a library on its own (see des.h) and included by
+// the command line tool.
+
+#include "SBox.cpp"
+#include "permute_lut.cpp"
+#include "permute_ct.cpp"
+
+// DES Tables
+// left shift table, position is the (round number - 1), value is the number of bits to shift and rotate
+constexpr int left_shift_table[16] = {1, 1, 2, 2, 2, 2, 2, 2, 1, 2, 2, 2, 2, 2, 2, 1};
+
+//permutaion choice 1 table
+constexpr int pc_1[56] = {  57 ,49 ,41 ,33 ,25 ,17 ,9  ,
+                        1  ,58 ,50 ,42 ,34 ,26 ,18 ,
+                        10 ,2  ,59 ,51 ,43 ,35 ,27 ,
+                        19 ,11 ,3  ,60 ,52 ,44 ,36 ,
+                        63 ,55 ,47 ,39 ,31 ,23 ,15 ,
+                        7  ,62 ,54 ,46 ,38 ,30 ,22 ,
+                        14 ,6  ,61 ,53 ,45 ,37 ,29 ,
+                        21 ,13 ,5  ,28 ,20 ,12 ,4 };
+
+
+//permutation choice 2 table
+constexpr int pc_2[48] = {  14 ,17 ,11 ,24 ,1  ,5  ,
+                        3  ,28 ,15 ,6  ,21 ,10 ,
+                        23 ,19 ,12 ,4  ,26 ,8  ,
+                        16 ,7  ,27 ,20 ,13 ,2  ,
+                        41 ,52 ,31 ,37 ,47 ,55 ,
+                        30 ,40 ,51 ,45 ,33 ,48 ,
+                        44 ,49 ,39 ,56 ,34 ,53 ,
+                        46 ,42 ,50 ,36 ,29 ,32 };              
+
+
+// intital permutation table
+constexpr int IP_t[64] = { 	58 ,50 ,42 ,34 ,26 ,18 ,10 ,2 ,  
+                        60 ,52 ,44 ,36 ,28 ,20 ,12 ,4 ,
+                        62 ,54 ,46 ,38 ,30 ,22 ,14 ,6 ,
+                        64 ,56 ,48 ,40 ,32 ,24 ,16 ,8 ,
+                        57 ,49 ,41 ,33 ,25 ,17 ,9  ,1 ,
+                        59 ,51 ,43 ,35 ,27 ,19 ,11 ,3 ,
+                        61 ,53 ,45 ,37 ,29 ,21 ,13 ,5 ,
+                        63 ,55 ,47 ,39 ,31 ,23 ,15 ,7 };    
+
+
+//final permutation table
+constexpr int P_1[64] = { 	40 ,8  ,48 ,16 ,56 ,24 ,64 ,32 ,
+                        39 ,7  ,47 ,15 ,55 ,23 ,63 ,31 ,
+                        38 ,6  ,46 ,14 ,54 ,22 ,62 ,30 ,
+                        37 ,5  ,45 ,13 ,53 ,21 ,61 ,29 ,
+                        36 ,4  ,44 ,12 ,52 ,20 ,60 ,28 ,
+                        35 ,3  ,43 ,11 ,51 ,19 ,59 ,27 ,
+                        34 ,2  ,42 ,10 ,50 ,18 ,58 ,26 ,
+                        33 ,1  ,41 ,9  ,49 ,17 ,57 ,25 };
+              
+
+
+ // expantion table
+constexpr int E_t[48] = { 	32 ,1  ,2  ,3  ,4  ,5  ,
+                        4  ,5  ,6  ,7  ,8  ,9  ,
+                        8  ,9  ,10 ,11 ,12 ,13 ,
+                        12 ,13 ,14 ,15 ,16 ,17 ,
+                        16 ,17 ,18 ,19 ,20 ,21 ,
+                        20 ,21 ,22 ,23 ,24 ,25 ,
+                        24 ,25 ,26 ,27 ,28 ,29 ,
+                        28 ,29 ,30 ,31 ,32 ,1 };
+
+
+// permutation table
+constexpr int P[32] = { 	16 ,7  ,20 ,21 ,
+                        29 ,12 ,28 ,17 ,
+                        1  ,15 ,23 ,26 ,
+                        5  ,18 ,31 ,10 ,
+                        2  ,8  ,24 ,14 ,
+                        32 ,27 ,3  ,9  ,
+                        19 ,13 ,30 ,6  ,
+                        22 ,11 ,4  ,25 };
+
+// byte-indexed lookup tables of the permutations above, built once by initPermutationTables()
+static PermutationLUT pc_1_lut, pc_2_lut, IP_lut, P_1_lut, E_lut, P_lut;
+
+// the same tables for permute<Table>(), which reads them when they are cheaper than its programs
+template <> inline const PermutationLUT& permutationLUT<pc_1>() { return pc_1_lut; }
+template <> inline const PermutationLUT& permutationLUT<pc_2>() { return pc_2_lut; }
+template <> inline const PermutationLUT& permutationLUT<IP_t>() { return IP_lut; }
+template <> inline const PermutationLUT& permutationLUT<P_1>() { return P_1_lut; }
+template <> inline const PermutationLUT& permutationLUT<E_t>() { return E_lut; }
+template <> inline const PermutationLUT& permutationLUT<P>() { return P_lut; }
+
+// byte order of the host, resolved at compile time
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ || __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__, "unsupported byte order");
+constexpr bool host_little_endian = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+
+/**
+ * @brief Load a block stored in file order (big-endian), a single movbe or load + bswap.
+ *
+ * @param p Address of the block, as stored in the file.
+ * @return 64-bit block, DES bit 1 is the most significant bit.
+ */
+static inline uint64_t loadBlock(const uint64_t* p) {
+    uint64_t value;
+    memcpy(&value, p, 8);
+    return host_little_endian ? __builtin_bswap64(value) : value;
+}
+
+/**
+ * @brief Store a block in file order (big-endian).
+ *
+ * @param p Address of the block, as stored in the file.
+ * @param value 64-bit block, DES bit 1 is the most significant bit.
+ */
+static inline void storeBlock(uint64_t* p, uint64_t value) {
+    if (host_little_endian) value = __builtin_bswap64(value);
+    memcpy(p, &value, 8);
+}
+
+// bitsliced engine, built on the tables above
+#include "bitslice.cpp"
+#include "gather.cpp"
+
+// number of independent blocks the scalar kernel pushes through the rounds together (2, 4 or 8),
+// can be set at build time with -DDES_INTERLEAVE=<n>
+#ifndef DES_INTERLEAVE
+#define DES_INTERLEAVE 4
+#endif
+static_assert(DES_INTERLEAVE == 2 || DES_INTERLEAVE == 4 || DES_INTERLEAVE == 8, "DES_INTERLEAVE must be 2, 4 or 8");
+
+// blocks decrypted or of keystream generated at once in CTR and CBC modes: the widest bitsliced batch,
+// 4 KiB on the stack
+const size_t ctr_tile_blocks = 512;
+
+// direction of the DES algorithm, resolved at compile time in the hot path
+enum DesDirection { DES_ENCRYPT, DES_DECRYPT };
+
+// the 16 48-bit subkeys of a key, in encryption (forward) and decryption (reverse) order
+struct KeySchedule {
+    uint64_t forward[16];
+    uint64_t reverse[16];
+};
+
+/**
+ * @brief Subkeys contributed by each key byte: the key schedule only moves bits, so the schedule of a key is
+ * the OR of the contributions of its 8 bytes.
+ *
+ * v[b][x][i] is subkey i of the key whose byte b (first byte first) holds the 7 key bits x followed by the
+ * parity bit, which no subkey takes, and whose other bytes are 0. 8 * 128 * 16 values, 128 KiB.
+ */
+struct KeyByteSubkeys {
+    uint64_t v[8][128][16];
+    constexpr KeyByteSubkeys() : v() {
+        for (int b = 0; b < 8; b++) {
+            for (int x = 1; x < 128; x++) {
+                // x is x & (x - 1) plus its lowest set bit, key bit 8 * b + 6 - ctz(x) (MSB first)
+                int bit = 8 * b + 6 - __builtin_ctz(x);
+                for (int i = 0; i < 16; i++) {
+                    v[b][x][i] = v[b][x & (x - 1)][i] | subkey_bit_masks.v[bit][i];
+                }
+            }
+        }
+    }
+};
+constexpr KeyByteSubkeys key_byte_subkeys;
+
+// subkeys of one direction prepared for every kernel, shared read-only by the worker threads,
+// 16 per stage: 1 stage for DES, 3 for triple DES
+struct KernelKeys {
+    const BitsliceKernel* kernel;  // bitsliced kernel the blocks go to
+    int stages;
+    uint64_t keys[48];
+    BitsliceKeys bitslice;
+    GatherKeys gather;
+};
+
+// one chain of the batched CBC encryption
+struct CbcStream {
+    uint64_t* blocks;  // padded plaintext as stored in the files, replaced by the ciphertext, accessed with memcpy
+    size_t count;      // number of blocks
+    uint64_t chain;    // IV, then the last ciphertext block, as stored in the files
+};
+
+
+/**
+ * @brief Build the byte-indexed lookup tables of all the DES permutation tables and the fused SP tables.
+ *
+ * Must be called before any encryption or decryption, the tables are built by the first call only, so it
+ * is safe to call several times and from several threads.
+ */
+static void initPermutationTables();
+
+/**
+ * @brief Swap the endianness of a 64-bit integer  (little-endian to big-endian only).
+ *
+ * @note The function uses the GCC built-in function __builtin_bswap64 to swap the endianness of the 64-bit integer.
+ * @note The function is only used for little-endian systems, otherwise, it returns the same value.
+ *
+ * @param value 64-bit integer to swap its endianness.
+ * @return 64-bit integer with big endianness.
+ */
+static inline uint64_t swapEndianness(uint64_t value);
+
+/**
+ * @brief Check if the system is little-endian, at compile time.
+ *
+ * @return true if the system is little-endian, false otherwise.
+ */
+static constexpr bool isLittleEndian();
+
+/**
+ * @brief Prepare the subkeys of one direction for every kernel.
+ *
+ * @param kernel_keys The prepared subkeys to fill.
+ * @param kernel Bitsliced kernel to use with them.
+ * @param keys Array of 16 * stages subkeys, in the order they are applied.
+ * @param stages 1 for DES, 3 for triple DES.
+ */
+static void prepareKernelKeys(KernelKeys& kernel_keys, const BitsliceKernel* kernel, const uint64_t* keys, int stages = 1);
+
+/**
+ * @brief Run the DES algorithm over a range of blocks.
+ *
+ * @param blocks Blocks to process in place, as stored in the files (big-endian).
+ * @param count Number of blocks.
+ * @param kernel_keys Subkeys prepared for the kernels, in the direction of the operation.
+ *
+ * The function uses the bitsliced kernel of kernel_keys on full batches. The remaining blocks go to the AVX2 gather
+ * kernel 8 at a time when a SIMD kernel is selected, then to the interleaved scalar kernel on groups of
+ * DES_INTERLEAVE blocks and to the DES function for the last blocks.
+ * Every kernel converts the byte order while loading and storing, so each block goes through the cache once.
+ * It is safe to call from several threads on disjoint ranges.
+ */
+static void processBlocks(uint64_t* blocks, size_t count, const KernelKeys& kernel_keys);
+
+/**
+ * @brief Run the DES algorithm over a range of blocks, each with its own DES key.
+ *
+ * @param blocks Blocks to process in place, as stored in the files (big-endian).
+ * @param keys One 64-bit key per block, as values.
+ * @param count Number of blocks.
+ * @param kernel Bitsliced kernel to use on full batches.
+ * @param direction Encrypt or decrypt.
+ *
+ * The keys are transposed with the blocks and renamed into round keys by the kernel, no key schedule is built.
+ * The last blocks are padded to the narrowest kernel that takes them in one call.
+ */
+static void processBlocksMultiKey(uint64_t* blocks, const uint64_t* keys, size_t count, const BitsliceKernel* kernel,
+                           DesDirection direction);
+
+/**
+ * @brief XOR a range of the data with the CTR keystream.
+ *
+ * @param input Data to process, as stored in the files.
+ * @param output Where to store the result, may be the same as input.
+ * @param size Number of bytes, the last block may be partial.
+ * @param counter Counter block of the first block of the range: the IV plus the index of the block.
+ * @param kernel_keys Subkeys prepared for the kernels, always in encryption order.
+ *
+ * The counter blocks are encrypted ctr_tile_blocks at a time by processBlocks(), so the keystream of
+ * any range can be generated independently of the others and uses the bitsliced kernels.
+ */
+static void ctrBlocks(const uint64_t* input, uint64_t* output, size_t size, uint64_t counter, const KernelKeys& kernel_keys);
+
+/**
+ * @brief Encrypt several independent CBC streams with the same key.
+ *
+ * @param streams The streams, their blocks are encrypted in place and their chain is updated.
+ * @param num_streams Number of streams.
+ * @param kernel_keys Subkeys prepared for the kernels, in encryption order.
+ *
+ * The chaining makes each stream serial, but the blocks of different streams are independent: each step
+ * XORs the next block of every unfinished stream with its chain and encrypts them together with
+ * processBlocks(), so enough streams fill the interleaved, gather or bitsliced kernels. A single stream gets
+ * no parallelism: its blocks go to the scalar DES function one at a time.
+ * The streams may have different lengths, they are run ctr_tile_blocks at a time without allocating.
+ */
+static void cbcEncryptStreams(CbcStream* streams, size_t num_streams, const KernelKeys& kernel_keys);
+
+/**
+ * @brief Decrypt a range of CBC blocks in place.
+ *
+ * @param blocks Ciphertext blocks as stored in the files, replaced by the plaintext.
+ * @param count Number of blocks.
+ * @param chain Ciphertext block preceding the range (the IV for the first block), as stored in the files.
+ * @param kernel_keys Subkeys prepared for the kernels, in decryption order.
+ */
+static void cbcDecryptBlocks(uint64_t* blocks, size_t count, uint64_t chain, const KernelKeys& kernel_keys);
+
+/**
+ * @brief General permutation function for DES.
+ *
+ * @param input The input data to permute.
+ * @param table The permutation table defining the new bit order.
+ * @param table_size The number of bits to permute.
+ * @param total_bits The total number of bits in the input.
+ * @return The permuted output data.
+ *
+ * The reference of the lookup tables and of the compiled permutations, the tests check them against it.
+ */
+[[maybe_unused]] static uint64_t permute(uint64_t input, const int* table, int table_size, int total_bits) {
+    uint64_t output = 0;
+    for(int i = 0; i < table_size; i++) {
+        output <<= 1;
+        // Extract the bit from the input based on the table
+        output |= (input >> (total_bits - table[i])) & 0x01;
+    }
+    return output;
+}
+
+/**
+ * @brief Generate the key schedule of a key, in both encryption and decryption order.
+ *
+ * @param schedule The key schedule to fill.
+ * @param key 64-bit key (parity bits included).
+ */
+static void buildKeySchedule(KeySchedule& schedule, uint64_t key);
+
+/**
+ * @brief Generate the key schedule of a key bit by bit: PC-1, the rotations and 16 PC-2.
+ *
+ * Same result as buildKeySchedule(), which looks the subkeys up instead. Kept as the reference to check
+ * and benchmark the tables against.
+ */
+[[maybe_unused]] static void buildKeyScheduleSerial(KeySchedule& schedule, uint64_t key);
+
+/**
+ * @brief Update a key schedule for the key with one bit flipped, without building it again.
+ *
+ * @param schedule Key schedule of a key, replaced by the one of the key with the bit flipped.
+ * @param bit The bit to flip (MSB first, DES bit bit + 1), a parity bit changes nothing.
+ *
+ * Enumerating keys in Gray-code order flips one bit from a key to the next, so each schedule costs 16 XORs.
+ */
+static inline void flipKeyBit(KeySchedule& schedule, int bit);
+
+/**
+ * @brief Perform the left shift and rotate operation on a 28-bit key at a specific round based on the left shift table in DES algorithm.
+ *
+ * @param value 32-bit integer to perform the left shift and rotate operation on.
+ * @param round The round number to determine the number of bits to shift and rotate.
+ * @return 32-bit integer after performing the left shift and rotate operation.
+ *
+ * The function performs the left shift and rotate operation on a 32-bit integer.
+ * The number of bits to shift and rotate is determined by the round number.
+ */
+static inline uint32_t leftShiftRotate(uint32_t value, int round);
+
+/**
+ * @brief Perform the DES algorithm on a 64-bit block using the generated keys.
+ *
+ * @param block 64-bit block to perform the DES algorithm on.
+ * @param keys Array of 16 * stages 64-bit integers to use in the DES algorithm.
+ * @param stages 1 for DES, 3 for triple DES.
+ * @return 64-bit block after performing the DES algorithm.
+ *
+ * The stages of triple DES run back to back: the FP of a stage and the IP of the next one cancel out
+ * and only swap the halves.
+ */
+static inline uint64_t DES(const uint64_t& block, const uint64_t* keys, int stages = 1);
+
+/**
+ * @brief Perform the DES algorithm on a 64-bit block in a fixed direction.
+ *
+ * @param block 64-bit block to perform the DES algorithm on.
+ * @param schedule Key schedule, its forward or reverse subkeys are used depending on the direction.
+ * @return 64-bit block after performing the DES algorithm.
+ */
+template <DesDirection Direction>
+static inline uint64_t DES(uint64_t block, const KeySchedule& schedule) {
+    return DES(block, Direction == DES_ENCRYPT ? schedule.forward : schedule.reverse);
+}
+
+/**
+ * @brief Perform the DES algorithm on N independent blocks at once.
+ *
+ * @param blocks Array of N 64-bit blocks as stored in the files (big-endian), processed in place.
+ * @param keys Array of 16 * stages 64-bit integers to use in the DES algorithm.
+ * @param stages 1 for DES, 3 for triple DES.
+ *
+ * The rounds of the N blocks are interleaved so that their table lookups overlap instead of
+ * waiting on each other, the result is the same as N calls to DES().
+ */
+template <int N>
+static inline void DES_interleaved(uint64_t* blocks, const uint64_t* keys, int stages = 1);
+
+/**
+ * @brief Perform the 16 rounds of the DES algorithm, fully unrolled.
+ *
+ * @param l 32-bit left half, holds L16 at the end.
+ * @param r 32-bit right half, holds R16 at the end.
+ * @param keys Array of 16 subkeys.
+ *
+ * Each pair of rounds updates l then r, so the halves alternate roles and are never swapped.
+ */
+template <size_t... I>
+static inline void DES_rounds(uint32_t& l, uint32_t& r, const uint64_t* keys, std::index_sequence<I...>);
+
+/**
+ * @brief Perform a single round of the DES algorithm on a 32-bit right half of the block.
+ *
+ * @param r 32-bit right half of the block to perform the DES round on.
+ * @param key 48-bit key to use in the DES round.
+ * @return 32-bit right half of the block after performing the DES round (right half operaions only).
+ *
+ */
+static inline uint64_t DES_round(uint64_t r, const uint64_t& key);
+
+static void initPermutationTables() {
+    static const bool initialized = [] {
+        buildPermutationLUT(pc_1_lut, pc_1, 56, 64);
+        buildPermutationLUT(pc_2_lut, pc_2, 48, 56);
+        buildPermutationLUT(IP_lut, IP_t, 64, 64);
+        buildPermutationLUT(P_1_lut, P_1, 64, 64);
+        buildPermutationLUT(E_lut, E_t, 48, 32);
+        buildPermutationLUT(P_lut, P, 32, 32);
+        buildSPTables(P);
+        return true;
+    }();
+    (void)initialized;
+}
+
+static inline uint64_t swapEndianness(uint64_t value) {
+    return isLittleEndian() ? __builtin_bswap64(value) : value;
+}
+
+static constexpr bool isLittleEndian() {
+    return host_little_endian;
+}
+
+static void prepareKernelKeys(KernelKeys& kernel_keys, const BitsliceKernel* kernel, const uint64_t* keys, int stages) {
+    kernel_keys.kernel = kernel;
+    kernel_keys.stages = stages;
+    for (int i = 0; i < 16 * stages; i++) {
+        kernel_keys.keys[i] = keys[i];
+    }
+    buildBitsliceKeys(kernel_keys.bitslice, keys, stages);
+    buildGatherKeys(kernel_keys.gather, keys, stages);
+}
+
+static void processBlocksMultiKey(uint64_t* blocks, const uint64_t* keys, size_t count, const BitsliceKernel* kernel,
+                           DesDirection direction) {
+    bool decrypt = (direction == DES_DECRYPT);
+    size_t i = 0;
+    for (; i + kernel->blocks <= count; i += kernel->blocks) {
+        kernel->run_keys(blocks + i, keys + i, decrypt);
+    }
+    if (i == count) return;
+
+    // the kernels after the selected one are narrower, and supported as well
+    const BitsliceKernel* tail = kernel;
+    while (tail + 1 < std::end(bitslice_kernels) && tail[1].blocks >= count - i) {
+        tail++;
+    }
+
+    alignas(64) uint64_t tail_blocks[ctr_tile_blocks];
+    alignas(64) uint64_t tail_keys[ctr_tile_blocks];
+    memset(tail_blocks, 0, tail->blocks * sizeof(uint64_t));
+    memset(tail_keys, 0, tail->blocks * sizeof(uint64_t));
+    memcpy(tail_blocks, blocks + i, (count - i) * sizeof(uint64_t));
+    memcpy(tail_keys, keys + i, (count - i) * sizeof(uint64_t));
+    tail->run_keys(tail_blocks, tail_keys, decrypt);
+    memcpy(blocks + i, tail_blocks, (count - i) * sizeof(uint64_t));
+}
+
+static void processBlocks(uint64_t* blocks, size_t count, const KernelKeys& kernel_keys) {
+    // bitsliced engine on full batches of the selected kernel
+    size_t i = 0;
+    const BitsliceKernel* kernel = kernel_keys.kernel;
+    for (; i + kernel->blocks <= count; i += kernel->blocks) {
+        kernel->run(blocks + i, kernel_keys.bitslice);
+    }
+
+    // the SIMD kernels imply AVX2: the gather kernel takes the rest 8 blocks at a time
+    if (kernel->blocks > 64) {
+        for (; i + 8 <= count; i += 8) {
+            DES_gather8(blocks + i, kernel_keys.gather);
+        }
+    }
+
+    // interleaved scalar kernel, then DES algorithm into each remaining block
+    for (; i + DES_INTERLEAVE <= count; i += DES_INTERLEAVE) {
+        DES_interleaved<DES_INTERLEAVE>(blocks + i, kernel_keys.keys, kernel_keys.stages);
+    }
+    for (; i < count; i++) {
+        storeBlock(blocks + i, DES(loadBlock(blocks + i), kernel_keys.keys, kernel_keys.stages));
+    }
+}
+
+static void ctrBlocks(const uint64_t* input, uint64_t* output, size_t size, uint64_t counter, const KernelKeys& kernel_keys) {
+    alignas(64) uint64_t keystream[ctr_tile_blocks];
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(input);
+    unsigned char* out = reinterpret_cast<unsigned char*>(output);
+
+    for (size_t offset = 0; offset < size; offset += ctr_tile_blocks * 8) {
+        size_t tile_size = std::min(ctr_tile_blocks * 8, size - offset);
+        size_t tile_blocks = (tile_size + 7) / 8;
+
+        // encrypt the counter blocks, stored big-endian like the data
+        uint64_t tile_counter = counter + offset / 8;
+        for (size_t j = 0; j < tile_blocks; j++) {
+            storeBlock(keystream + j, tile_counter + j);
+        }
+        processBlocks(keystream, tile_blocks, kernel_keys);
+
+        // XOR the keystream into the data, byte by byte for a partial last block
+        size_t j = 0;
+        for (; j + 8 <= tile_size; j += 8) {
+            uint64_t word;
+            memcpy(&word, in + offset + j, 8);
+            word ^= keystream[j / 8];
+            memcpy(out + offset + j, &word, 8);
+        }
+        for (; j < tile_size; j++) {
+            out[offset + j] = in[offset + j] ^ reinterpret_cast<const unsigned char*>(keystream)[j];
+        }
+    }
+}
+
+static void cbcEncryptStreams(CbcStream* streams, size_t num_streams, const KernelKeys& kernel_keys) {
+    alignas(64) uint64_t batch[ctr_tile_blocks];
+    CbcStream* active[ctr_tile_blocks];
+
+    for (size_t group = 0; group < num_streams; group += ctr_tile_blocks) {
+        size_t group_size = std::min(ctr_tile_blocks, num_streams - group);
+
+        for (size_t step = 0;; step++) {
+            // next block of every unfinished stream, XORed with its chain (the XOR does not depend on the byte order)
+            size_t n = 0;
+            for (size_t s = group; s < group + group_size; s++) {
+                if (step < streams[s].count) {
+                    uint64_t block;
+                    memcpy(&block, streams[s].blocks + step, 8);
+                    active[n] = &streams[s];
+                    batch[n++] = block ^ streams[s].chain;
+                }
+            }
+            if (n == 0) break;
+
+            processBlocks(batch, n, kernel_keys);
+
+            for (size_t k = 0; k < n; k++) {
+                memcpy(active[k]->blocks + step, &batch[k], 8);
+                active[k]->chain = batch[k];
+            }
+        }
+    }
+}
+
+static void cbcDecryptBlocks(uint64_t* blocks, size_t count, uint64_t chain, const KernelKeys& kernel_keys) {
+    alignas(64) uint64_t plain[ctr_tile_blocks];
+
+    for (size_t offset = 0; offset < count; offset += ctr_tile_blocks) {
+        size_t tile_blocks = std::min(ctr_tile_blocks, count - offset);
+
+        // decrypt a copy of the tile, the ciphertext is still needed for the chaining
+        memcpy(plain, blocks + offset, tile_blocks * 8);
+        processBlocks(plain, tile_blocks, kernel_keys);
+
+        for (size_t j = 0; j < tile_blocks; j++) {
+            uint64_t cipher = blocks[offset + j];
+            blocks[offset + j] = plain[j] ^ chain;
+            chain = cipher;
+        }
+    }
+}
+
+static void buildKeySchedule(KeySchedule& schedule, uint64_t key) {
+    // contributions of the 8 key bytes, without their parity bits
+    const uint64_t* contributions[8];
+    for (int b = 0; b < 8; b++) {
+        contributions[b] = key_byte_subkeys.v[b][(key >> (57 - 8 * b)) & 0x7F];
+    }
+
+    // OR them into every subkey, stored in both orders
+    for (int i = 0; i < 16; i++) {
+        uint64_t subkey = contributions[0][i] | contributions[1][i] | contributions[2][i] | contributions[3][i] |
+                          contributions[4][i] | contributions[5][i] | contributions[6][i] | contributions[7][i];
+        schedule.forward[i] = subkey;
+        schedule.reverse[15 - i] = subkey;
+    }
+}
+
+static void buildKeyScheduleSerial(KeySchedule& schedule, uint64_t key) {
+    // Apply Permuted Choice 1 to the original key
+    uint64_t permuted_key = permute<pc_1>(key);
+
+    // Split the permuted key into two 28-bit halves
+    uint32_t C = (permuted_key >> 28) & 0x0FFFFFFF; // Left half
+    uint32_t D = permuted_key & 0x0FFFFFFF;         // Right half
+
+    // Generate 16 subkeys
+    for (int i = 0; i < 16; i++) {
+        // Perform left shifts according to the shift table
+        C = leftShiftRotate(C, i);
+        D = leftShiftRotate(D, i);
+
+        // Combine C and D into a 56-bit key
+        uint64_t combined_halves = ((uint64_t)C << 28) | D;
+
+        // Apply Permuted Choice 2 to get the 48-bit subkey, stored in both orders
+        schedule.forward[i] = permute<pc_2, 56>(combined_halves);
+        schedule.reverse[15 - i] = schedule.forward[i];
+    }
+}
+
+static inline void flipKeyBit(KeySchedule& schedule, int bit) {
+    for (int i = 0; i < 16; i++) {
+        schedule.forward[i] ^= subkey_bit_masks.v[bit][i];
+        schedule.reverse[15 - i] ^= subkey_bit_masks.v[bit][i];
+    }
+}
+
+static inline uint32_t leftShiftRotate(uint32_t value, int round) {
+    int shifts = left_shift_table[round];
+    return ((value << shifts) | (value >> (28 - shifts))) & 0x0FFFFFFF;
+}
+
+static uint64_t DES(const uint64_t& block, const uint64_t* keys, int stages) {
+    // initial permutation
+    uint64_t block_new = permute<IP_t>(block);
+
+    uint32_t l = static_cast<uint32_t>(block_new >> 32);
+    uint32_t r = static_cast<uint32_t>(block_new & 0xFFFFFFFF);
+
+    // perform 16 rounds per stage, the halves are swapped between the stages
+    for (int s = 0; s < stages; s++) {
+        if (s > 0) std::swap(l, r);
+        DES_rounds(l, r, keys + 16 * s, std::make_index_sequence<8>());
+    }
+
+    // combine the two halves and swap them
+    block_new = ((uint64_t)r << 32) | l;
+
+    // final permutation
+    uint64_t fp_output = permute<P_1>(block_new);
+
+    return fp_output;
+}
+
+template <int N>
+static inline void DES_interleaved(uint64_t* blocks, const uint64_t* keys, int stages) {
+    uint32_t l[N], r[N];
+
+    // initial permutation
+    for (int b = 0; b < N; b++) {
+        uint64_t block_new = permute<IP_t>(loadBlock(blocks + b));
+        l[b] = static_cast<uint32_t>(block_new >> 32);
+        r[b] = static_cast<uint32_t>(block_new & 0xFFFFFFFF);
+    }
+
+    // perform 16 rounds per stage, each round over all the blocks before the next one
+    for (int s = 0; s < stages; s++) {
+        if (s > 0) {
+            for (int b = 0; b < N; b++) std::swap(l[b], r[b]);
+        }
+        for (int i = 16 * s; i < 16 * s + 16; i += 2) {
+#pragma GCC unroll 8
+            for (int b = 0; b < N; b++) l[b] ^= DES_round(r[b], keys[i]);
+#pragma GCC unroll 8
+            for (int b = 0; b < N; b++) r[b] ^= DES_round(l[b], keys[i + 1]);
+        }
+    }
+
+    // combine the two halves, swap them and apply the final permutation
+    for (int b = 0; b < N; b++) {
+        storeBlock(blocks + b, permute<P_1>(((uint64_t)r[b] << 32) | l[b]));
+    }
+}
+
+template <size_t... I>
+static inline void DES_rounds(uint32_t& l, uint32_t& r, const uint64_t* keys, std::index_sequence<I...>) {
+    ((l ^= DES_round(r, keys[2 * I]), r ^= DES_round(l, keys[2 * I + 1])), ...);
+}
+
+static uint64_t DES_round(uint64_t r, const uint64_t& key) {
+    // right half operations
+
+    // expansion permutation
+    uint64_t expanded_r = permute<E_t, 32>(r);
+
+    // XOR with key, both 48 bits
+    uint64_t xor_r = (expanded_r ^ key);
+
+    // S-boxes and permutation through the fused SP tables, result is 32 bits
+    // (reference path: permute(SBox(xor_r), P_lut))
+    uint32_t permuted_output = SPBox(xor_r);
+
+    // combine the two halves
+    return permuted_output;
+}
+
+// public interface, see des.h
+
+DesKey::DesKey(uint64_t key) : num_stages(1) {
+    KeySchedule schedule;
+    buildKeySchedule(schedule, key);
+    memcpy(encryption, schedule.forward, sizeof(schedule.forward));
+    memcpy(decryption, schedule.reverse, sizeof(schedule.reverse));
+}
+
+DesKey::DesKey(uint64_t k1, uint64_t k2, uint64_t k3) : num_stages(3) {
+    KeySchedule schedules[3];
+    const uint64_t keys[3] = {k1, k2, k3};
+    for (int k = 0; k < 3; k++) {
+        buildKeySchedule(schedules[k], keys[k]);
+    }
+
+    // the stages alternate directions, in reverse key order to decrypt
+    for (int s = 0; s < 3; s++) {
+        const KeySchedule& encrypt_schedule = schedules[s];
+        const KeySchedule& decrypt_schedule = schedules[2 - s];
+        memcpy(encryption + 16 * s, s == 1 ? encrypt_schedule.reverse : encrypt_schedule.forward, 16 * sizeof(uint64_t));
+        memcpy(decryption + 16 * s, s == 1 ? decrypt_schedule.forward : decrypt_schedule.reverse, 16 * sizeof(uint64_t));
+    }
+}
+
+struct DesContext::State {
+    KernelKeys encryption;
+    KernelKeys decryption;
+};
+
+DesContext::DesContext(const DesKey& key, const char* kernel) : state(new State) {
+    initPermutationTables();
+
+    const BitsliceKernel* bitslice_kernel = selectBitsliceKernel(kernel);
+    if (bitslice_kernel == nullptr) {
+        bitslice_kernel = selectBitsliceKernel("auto");
+    }
+    prepareKernelKeys(state->encryption, bitslice_kernel, key.encryption_keys(), key.stages());
+    prepareKernelKeys(state->decryption, bitslice_kernel, key.decryption_keys(), key.stages());
+}
+
+DesContext::~DesContext() = default;
+DesContext::DesContext(DesContext&&) noexcept = default;
+DesContext& DesContext::operator=(DesContext&&) noexcept = default;
+
+const char* DesContext::kernel() const {
+    return state->encryption.kernel->name;
+}
+
+/**
+ * @brief Run processBlocks() over blocks given as values, through a tile in file order.
+ */
+static void processValues(const uint64_t* input, uint64_t* output, size_t count, const KernelKeys& kernel_keys) {
+    alignas(64) uint64_t tile[ctr_tile_blocks];
+    for (size_t offset = 0; offset < count; offset += ctr_tile_blocks) {
+        size_t tile_blocks = std::min(ctr_tile_blocks, count - offset);
+        for (size_t j = 0; j < tile_blocks; j++) storeBlock(tile + j, input[offset + j]);
+        processBlocks(tile, tile_blocks, kernel_keys);
+        for (size_t j = 0; j < tile_blocks; j++) output[offset + j] = loadBlock(tile + j);
+    }
+}
+
+/**
+ * @brief Check if bytes can be processed in place as blocks.
+ */
+static bool blockAligned(const uint8_t* bytes) {
+    return reinterpret_cast<uintptr_t>(bytes) % alignof(uint64_t) == 0;
+}
+
+/**
+ * @brief Run processBlocks() over bytes, a tile at a time.
+ *
+ * An aligned output is processed in place, the tile of the input is copied to it first unless it is the same
+ * buffer. Otherwise the tiles go through an aligned buffer.
+ */
+static bool processBytes(const uint8_t* input, uint8_t* output, size_t size, const KernelKeys& kernel_keys) {
+    if (size % 8 != 0) return false;
+
+    alignas(64) uint64_t tile[ctr_tile_blocks];
+    bool in_place = blockAligned(output);
+    for (size_t offset = 0; offset < size; offset += sizeof(tile)) {
+        size_t tile_size = std::min(sizeof(tile), size - offset);
+        uint64_t* blocks = in_place ? reinterpret_cast<uint64_t*>(output + offset) : tile;
+        if (reinterpret_cast<uint8_t*>(blocks) != input + offset) {
+            memcpy(blocks, input + offset, tile_size);
+        }
+        processBlocks(blocks, tile_size / 8, kernel_keys);
+        if (!in_place) {
+            memcpy(output + offset, tile, tile_size);
+        }
+    }
+    return true;
+}
+
+void DesContext::encrypt_blocks(const uint64_t* input, uint64_t* output, size_t count) const {
+    processValues(input, output, count, state->encryption);
+}
+
+void DesContext::decrypt_blocks(const uint64_t* input, uint64_t* output, size_t count) const {
+    processValues(input, output, count, state->decryption);
+}
+
+/**
+ * @brief Run processBlocksMultiKey() over blocks given as values, through a tile in file order.
+ */
+static void processValuesMultiKey(const uint64_t* keys, const uint64_t* input, uint64_t* output, size_t count,
+                                  const BitsliceKernel* kernel, DesDirection direction) {
+    alignas(64) uint64_t tile[ctr_tile_blocks];
+    for (size_t offset = 0; offset < count; offset += ctr_tile_blocks) {
+        size_t tile_blocks = std::min(ctr_tile_blocks, count - offset);
+        for (size_t j = 0; j < tile_blocks; j++) storeBlock(tile + j, input[offset + j]);
+        processBlocksMultiKey(tile, keys + offset, tile_blocks, kernel, direction);
+        for (size_t j = 0; j < tile_blocks; j++) output[offset + j] = loadBlock(tile + j);
+    }
+}
+
+bool DesContext::encrypt_bytes(const uint8_t* input, uint8_t* output, size_t size) const {
+    return processBytes(input, output, size, state->encryption);
+}
+
+bool DesContext::decrypt_bytes(const uint8_t* input, uint8_t* output, size_t size) const {
+    return processBytes(input, output, size, state->decryption);
+}
+
+void DesContext::ctr_bytes(const uint8_t* input, uint8_t* output, size_t size, uint64_t counter) const {
+    // ctrBlocks() only accesses the data byte-wise or through memcpy
+    ctrBlocks(reinterpret_cast<const uint64_t*>(input), reinterpret_cast<uint64_t*>(output), size, counter,
+              state->encryption);
+}
+
+bool DesContext::cbc_encrypt_bytes(const uint8_t* input, uint8_t* output, size_t size, uint64_t& chain) const {
+    if (size % 8 != 0) return false;
+
+    // cbcEncryptStreams() copies each block in and out, so the output is encrypted in place
+    if (output != input) {
+        memmove(output, input, size);
+    }
+    DesCbcStream stream = {output, size, chain};
+    cbc_encrypt_streams(&stream, 1);
+    chain = stream.chain;
+    return true;
+}
+
+bool DesContext::cbc_decrypt_bytes(const uint8_t* input, uint8_t* output, size_t size, uint64_t& chain) const {
+    if (size % 8 != 0) return false;
+
+    // same tiles as processBytes(), the last ciphertext block of a tile is kept for the next one
+    alignas(64) uint64_t tile[ctr_tile_blocks];
+    bool in_place = blockAligned(output);
+    uint64_t previous;
+    storeBlock(&previous, chain);
+    for (size_t offset = 0; offset < size; offset += sizeof(tile)) {
+        size_t tile_size = std::min(sizeof(tile), size - offset);
+        uint64_t* blocks = in_place ? reinterpret_cast<uint64_t*>(output + offset) : tile;
+        uint64_t last;
+        memcpy(&last, input + offset + tile_size - 8, 8);
+        if (reinterpret_cast<uint8_t*>(blocks) != input + offset) {
+            memcpy(blocks, input + offset, tile_size);
+        }
+        cbcDecryptBlocks(blocks, tile_size / 8, previous, state->decryption);
+        if (!in_place) {
+            memcpy(output + offset, tile, tile_size);
+        }
+        previous = last;
+    }
+    chain = loadBlock(&previous);
+    return true;
+}
+
+bool DesContext::cbc_encrypt_streams(DesCbcStream* streams, size_t num_streams) const {
+    for (size_t s = 0; s < num_streams; s++) {
+        if (streams[s].size % 8 != 0) return false;
+    }
+
+    // cbcEncryptStreams() takes the chains in file order, a group of ctr_tile_blocks streams at a time
+    CbcStream group[ctr_tile_blocks];
+    for (size_t first = 0; first < num_streams; first += ctr_tile_blocks) {
+        size_t group_size = std::min(ctr_tile_blocks, num_streams - first);
+        for (size_t s = 0; s < group_size; s++) {
+            group[s].blocks = reinterpret_cast<uint64_t*>(streams[first + s].data);
+            group[s].count = streams[first + s].size / 8;
+            storeBlock(&group[s].chain, streams[first + s].chain);
+        }
+        cbcEncryptStreams(group, group_size, state->encryption);
+        for (size_t s = 0; s < group_size; s++) {
+            streams[first + s].chain = loadBlock(&group[s].chain);
+        }
+    }
+    return true;
+}
+
+DesMultiKey::DesMultiKey(const char* kernel) {
+    initPermutationTables();
+
+    bitslice_kernel = selectBitsliceKernel(kernel);
+    if (bitslice_kernel == nullptr) {
+        bitslice_kernel = selectBitsliceKernel("auto");
+    }
+}
+
+const char* DesMultiKey::kernel() const {
+    return bitslice_kernel->name;
+}
+
+void DesMultiKey::encrypt_blocks(const uint64_t* keys, const uint64_t* input, uint64_t* output, size_t count) const {
+    processValuesMultiKey(keys, input, output, count, bitslice_kernel, DES_ENCRYPT);
+}
+
+void DesMultiKey::decrypt_blocks(const uint64_t* keys, const uint64_t* input, uint64_t* output, size_t count) const {
+    processValuesMultiKey(keys, input, output, count, bitslice_kernel, DES_DECRYPT);
+}
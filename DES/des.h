@@ -0,0 +1,226 @@
+// Public interface of the DES engine.
+//
+// Build the library from des.cpp, which includes the engine modules (see README.md):
+//   g++ -O2 -std=c++17 -c DES/des.cpp -o des.o && ar rcs libdes.a des.o
+//   g++ -O2 -std=c++17 -fPIC -fvisibility=hidden -shared DES/des.cpp -o libdes.so
+// The command line tool includes des.cpp: it processes the files through DesContext, and its search
+// subcommand uses the bitsliced kernels directly.
+
+#ifndef DES_H
+#define DES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+
+#if __cplusplus >= 202002L && __has_include(<span>)
+#include <span>
+#define DES_HAS_SPAN
+#endif
+
+#define DES_API __attribute__((visibility("default")))
+
+struct BitsliceKernel;
+
+/**
+ * @brief One chain of DesContext::cbc_encrypt_streams(), e.g. a file or a network stream.
+ */
+struct DesCbcStream {
+    uint8_t* data;   // padded plaintext, replaced by the ciphertext in place
+    size_t size;     // bytes, a multiple of 8
+    uint64_t chain;  // the IV, replaced by the last ciphertext block
+};
+
+/**
+ * @brief Expanded key schedule of a DES or triple DES (EDE) key.
+ *
+ * Holds the 16 subkeys of every stage in encryption and decryption order. It is immutable once built,
+ * so a key can be shared by any number of contexts and threads.
+ */
+class DES_API DesKey {
+public:
+    /**
+     * @brief Expand a DES key.
+     *
+     * @param key 64-bit key, parity bits included, DES bit 1 is the most significant bit.
+     */
+    explicit DesKey(uint64_t key);
+
+    /**
+     * @brief Expand a triple DES key, E(K1) D(K2) E(K3) to encrypt. Keying option 2 passes K1 as k3.
+     */
+    DesKey(uint64_t k1, uint64_t k2, uint64_t k3);
+
+    /**
+     * @brief Number of 16-round stages, 1 for DES and 3 for triple DES.
+     */
+    int stages() const { return num_stages; }
+
+    /**
+     * @brief The 16 * stages() 48-bit subkeys in the order they are applied to encrypt.
+     */
+    const uint64_t* encryption_keys() const { return encryption; }
+
+    /**
+     * @brief The 16 * stages() 48-bit subkeys in the order they are applied to decrypt.
+     */
+    const uint64_t* decryption_keys() const { return decryption; }
+
+private:
+    int num_stages;
+    uint64_t encryption[48];
+    uint64_t decryption[48];
+};
+
+/**
+ * @brief A key prepared for every kernel of the engine, in both directions.
+ *
+ * The operations are const, allocation-free and run on the calling thread, so one context can be used by
+ * several threads at once. Input and output may be the same buffer.
+ *
+ * The block operations take 64-bit values (DES bit 1 is the most significant bit), the byte operations
+ * take bytes in the standard order (the first byte holds DES bits 1 to 8).
+ */
+class DES_API DesContext {
+public:
+    /**
+     * @brief Prepare a key.
+     *
+     * @param key The expanded key.
+     * @param kernel Bitsliced kernel to use (auto, avx512, avx2 or portable), the widest supported one is
+     *               used if it is unknown or not supported by this CPU.
+     */
+    explicit DesContext(const DesKey& key, const char* kernel = "auto");
+    ~DesContext();
+
+    DesContext(DesContext&&) noexcept;
+    DesContext& operator=(DesContext&&) noexcept;
+
+    /**
+     * @brief Name of the bitsliced kernel in use.
+     */
+    const char* kernel() const;
+
+    /**
+     * @brief Encrypt or decrypt count blocks (ECB).
+     */
+    void encrypt_blocks(const uint64_t* input, uint64_t* output, size_t count) const;
+    void decrypt_blocks(const uint64_t* input, uint64_t* output, size_t count) const;
+
+#ifdef DES_HAS_SPAN
+    /**
+     * @brief Encrypt or decrypt blocks (ECB).
+     *
+     * @return false if the spans have different sizes, nothing is processed then.
+     *
+     * Defined here so that the library does not depend on the language version it is built with.
+     */
+    bool encrypt_blocks(std::span<const uint64_t> input, std::span<uint64_t> output) const {
+        if (input.size() != output.size()) return false;
+        encrypt_blocks(input.data(), output.data(), input.size());
+        return true;
+    }
+
+    bool decrypt_blocks(std::span<const uint64_t> input, std::span<uint64_t> output) const {
+        if (input.size() != output.size()) return false;
+        decrypt_blocks(input.data(), output.data(), input.size());
+        return true;
+    }
+#endif
+
+    /**
+     * @brief Encrypt or decrypt bytes (ECB).
+     *
+     * @return false if size is not a multiple of 8, nothing is processed then.
+     */
+    bool encrypt_bytes(const uint8_t* input, uint8_t* output, size_t size) const;
+    bool decrypt_bytes(const uint8_t* input, uint8_t* output, size_t size) const;
+
+    /**
+     * @brief XOR bytes with the CTR keystream, to encrypt or decrypt.
+     *
+     * @param counter Counter block of the first byte: the IV plus the index of its block in the stream.
+     *
+     * The last block may be partial. Any part of a stream can be processed independently.
+     */
+    void ctr_bytes(const uint8_t* input, uint8_t* output, size_t size, uint64_t counter) const;
+
+    /**
+     * @brief Encrypt or decrypt bytes in CBC mode, without padding.
+     *
+     * @param chain The IV, replaced by the last ciphertext block so that a stream can be processed in parts.
+     * @return false if size is not a multiple of 8, nothing is processed then.
+     */
+    bool cbc_encrypt_bytes(const uint8_t* input, uint8_t* output, size_t size, uint64_t& chain) const;
+    bool cbc_decrypt_bytes(const uint8_t* input, uint8_t* output, size_t size, uint64_t& chain) const;
+
+    /**
+     * @brief Encrypt several independent streams in CBC mode, without padding.
+     *
+     * @return false if the size of a stream is not a multiple of 8, nothing is processed then.
+     *
+     * A CBC chain is serial, so a single stream runs one block at a time. Independent streams are encrypted
+     * together, one block of each per step, and enough of them (a few hundred) fill the bitsliced kernels.
+     */
+    bool cbc_encrypt_streams(DesCbcStream* streams, size_t num_streams) const;
+
+private:
+    struct State;
+    std::unique_ptr<State> state;
+};
+
+/**
+ * @brief DES with its own key for every block, e.g. a key per database record.
+ *
+ * The bitsliced kernels transpose the keys with the blocks, and the key schedule of bit-planes only
+ * renames them, so no key is expanded on its own and a batch runs close to the speed of a single key.
+ * Batches of a few thousand blocks fill the kernels, the last blocks are padded.
+ *
+ * The operations are const, allocation-free and thread-safe. Blocks and keys are 64-bit values (DES
+ * bit 1 is the most significant bit, parity bits are ignored), input and output may be the same buffer.
+ */
+class DES_API DesMultiKey {
+public:
+    /**
+     * @brief Select the kernel.
+     *
+     * @param kernel Bitsliced kernel to use, as for DesContext.
+     */
+    explicit DesMultiKey(const char* kernel = "auto");
+
+    /**
+     * @brief Name of the bitsliced kernel in use.
+     */
+    const char* kernel() const;
+
+    /**
+     * @brief Encrypt or decrypt count blocks (ECB), block i with keys[i].
+     */
+    void encrypt_blocks(const uint64_t* keys, const uint64_t* input, uint64_t* output, size_t count) const;
+    void decrypt_blocks(const uint64_t* keys, const uint64_t* input, uint64_t* output, size_t count) const;
+
+#ifdef DES_HAS_SPAN
+    /**
+     * @brief Encrypt or decrypt blocks (ECB), block i with keys[i].
+     *
+     * @return false if the spans have different sizes, nothing is processed then.
+     */
+    bool encrypt_blocks(std::span<const uint64_t> keys, std::span<const uint64_t> input, std::span<uint64_t> output) const {
+        if (keys.size() != input.size() || input.size() != output.size()) return false;
+        encrypt_blocks(keys.data(), input.data(), output.data(), input.size());
+        return true;
+    }
+
+    bool decrypt_blocks(std::span<const uint64_t> keys, std::span<const uint64_t> input, std::span<uint64_t> output) const {
+        if (keys.size() != input.size() || input.size() != output.size()) return false;
+        decrypt_blocks(keys.data(), input.data(), output.data(), input.size());
+        return true;
+    }
+#endif
+
+private:
+    const BitsliceKernel* bitslice_kernel;
+};
+
+#endif
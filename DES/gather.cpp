@@ -0,0 +1,103 @@
+#include <stdint.h>
+
+#include <immintrin.h>
+
+#include <utility>
+
+// AVX2 gather kernel: 8 blocks per call, one block per 32-bit lane of __m256i halves.
+//
+// The expansion of the right half is done with lane rotations: the 6-bit input of S-box n is the
+// window of R starting at DES bit 4n (bit 32 for n = 0), so rotating R left by 4n - 1 brings it to
+// the top 6 bits. The subkey is XORed per S-box and vpgatherdd reads the fused SP tables, so a
+// round is 8 gathers and 8 ORs for 8 blocks. IP and FP are done per block with the compiled
+// permutations, on blocks loaded and stored big-endian.
+//
+// Uses the SP tables and the DES tables, so it is included after their definitions.
+
+/**
+ * @brief Subkeys split into the 6-bit S-box inputs they are XORed with.
+ *
+ * chunks[i][n] is the part of subkey i that goes into S-box n+1. Triple DES chains 3 stages of 16 rounds.
+ */
+struct GatherKeys {
+    int stages;
+    uint32_t chunks[48][8];
+};
+
+/**
+ * @brief Split 16 subkeys per stage into their 6-bit chunks.
+ *
+ * @param gather_keys The chunks to fill.
+ * @param keys Array of 16 * stages 48-bit subkeys, in the order they are applied.
+ * @param stages 1 for DES, 3 for triple DES.
+ */
+static void buildGatherKeys(GatherKeys& gather_keys, const uint64_t* keys, int stages = 1) {
+    gather_keys.stages = stages;
+    for (int i = 0; i < 16 * stages; i++) {
+        for (int n = 0; n < 8; n++) {
+            gather_keys.chunks[i][n] = (keys[i] >> (42 - 6 * n)) & 0x3F;
+        }
+    }
+}
+
+/**
+ * @brief DES round function on 8 right halves: P(S(E(r) ^ key)).
+ *
+ * @param r 8 32-bit right halves.
+ * @param chunks The 8 6-bit chunks of the subkey.
+ * @return 8 32-bit round outputs.
+ */
+static __attribute__((target("avx2"))) inline __m256i gatherRound(__m256i r, const uint32_t* chunks) {
+    __m256i output = _mm256_setzero_si256();
+#pragma GCC unroll 8
+    for (int n = 0; n < 8; n++) {
+        // expansion: rotate the 6-bit window of S-box n to the top, then shift it down
+        int shift = (4 * n + 31) & 31;
+        __m256i rotated = _mm256_or_si256(_mm256_slli_epi32(r, shift), _mm256_srli_epi32(r, 32 - shift));
+        __m256i index = _mm256_xor_si256(_mm256_srli_epi32(rotated, 26), _mm256_set1_epi32(chunks[n]));
+
+        output = _mm256_or_si256(output, _mm256_i32gather_epi32(reinterpret_cast<const int*>(SP[n]), index, 4));
+    }
+    return output;
+}
+
+/**
+ * @brief Encrypt or decrypt 8 blocks in place with the AVX2 gather kernel.
+ *
+ * @param blocks Array of 8 64-bit blocks, as stored in the files (big-endian).
+ * @param gather_keys Subkey chunks, in the order they are applied.
+ *
+ * The result is identical to 8 calls to DES() with the same stages.
+ */
+static __attribute__((target("avx2"))) void DES_gather8(uint64_t* blocks, const GatherKeys& gather_keys) {
+    alignas(32) uint32_t l[8], r[8];
+
+    // initial permutation
+    for (int b = 0; b < 8; b++) {
+        uint64_t block_new = permute<IP_t>(loadBlock(blocks + b));
+        l[b] = static_cast<uint32_t>(block_new >> 32);
+        r[b] = static_cast<uint32_t>(block_new & 0xFFFFFFFF);
+    }
+
+    __m256i L = _mm256_load_si256(reinterpret_cast<const __m256i*>(l));
+    __m256i R = _mm256_load_si256(reinterpret_cast<const __m256i*>(r));
+
+    // perform 16 rounds per stage, the halves alternate roles and are swapped between the stages
+    // of triple DES, where FP and IP cancel out
+    for (int s = 0; s < gather_keys.stages; s++) {
+        if (s > 0) std::swap(L, R);
+
+        for (int i = 16 * s; i < 16 * s + 16; i += 2) {
+            L = _mm256_xor_si256(L, gatherRound(R, gather_keys.chunks[i]));
+            R = _mm256_xor_si256(R, gatherRound(L, gather_keys.chunks[i + 1]));
+        }
+    }
+
+    _mm256_store_si256(reinterpret_cast<__m256i*>(l), L);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(r), R);
+
+    // combine the two halves, swap them and apply the final permutation
+    for (int b = 0; b < 8; b++) {
+        storeBlock(blocks + b, permute<P_1>(((uint64_t)r[b] << 32) | l[b]));
+    }
+}
@@ -0,0 +1,159 @@
+// Minimal io_uring wrapper on the raw system calls (no liburing).
+//
+// Only what the asynchronous file backend needs: one submission and one completion ring, fixed
+// (registered) buffers and read/write operations at explicit offsets.
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define has_io_uring
+
+/**
+ * @brief An io_uring instance with its submission and completion rings mapped.
+ */
+class IoUring {
+public:
+    IoUring() = default;
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    ~IoUring() {
+        if (sqes != MAP_FAILED) munmap(sqes, sqes_size);
+        if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) munmap(cq_ptr, cq_size);
+        if (sq_ptr != MAP_FAILED) munmap(sq_ptr, sq_size);
+        if (ring_fd >= 0) close(ring_fd);
+    }
+
+    /**
+     * @brief Create the rings.
+     *
+     * @param entries Number of submission queue entries.
+     * @return true on success, false if the kernel does not provide io_uring.
+     */
+    bool init(unsigned entries) {
+        struct io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (ring_fd < 0) return false;
+
+        sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap && cq_size > sq_size) sq_size = cq_size;
+
+        sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        if (sq_ptr == MAP_FAILED) return false;
+        cq_ptr = single_mmap ? sq_ptr
+                             : mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ptr == MAP_FAILED) return false;
+
+        sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+        sqes = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) return false;
+
+        char* sq = static_cast<char*>(sq_ptr);
+        sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+        char* cq = static_cast<char*>(cq_ptr);
+        cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    /**
+     * @brief Register buffers for IORING_OP_READ_FIXED / IORING_OP_WRITE_FIXED.
+     *
+     * @return true on success, false if they could not be registered (e.g. locked memory limit).
+     */
+    bool registerBuffers(const struct iovec* iovecs, unsigned count) {
+        return syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, iovecs, count) == 0;
+    }
+
+    /**
+     * @brief Queue a read or write, submitted by the next call to submitAndWait().
+     *
+     * @param opcode IORING_OP_READ(_FIXED) or IORING_OP_WRITE(_FIXED).
+     * @param buf_index Index of the registered buffer, for the fixed variants.
+     * @param user_data Value returned with the completion.
+     */
+    void prepare(uint8_t opcode, int fd, void* addr, unsigned length, uint64_t offset, uint16_t buf_index, uint64_t user_data) {
+        unsigned tail = *sq_tail;
+        unsigned index = tail & sq_mask;
+        struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(sqes) + index;
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = opcode;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(addr);
+        sqe->len = length;
+        sqe->off = offset;
+        sqe->buf_index = buf_index;
+        sqe->user_data = user_data;
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        to_submit++;
+    }
+
+    /**
+     * @brief Submit the queued operations and wait for at least min_complete completions.
+     *
+     * @return true on success, false on a system call error.
+     */
+    bool submitAndWait(unsigned min_complete) {
+        while (true) {
+            long ret = syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (ret >= 0) {
+                to_submit -= static_cast<unsigned>(ret);
+                return true;
+            }
+            if (errno != EINTR) return false;
+        }
+    }
+
+    /**
+     * @brief Take the next completion if there is one.
+     */
+    bool popCompletion(struct io_uring_cqe& cqe) {
+        unsigned head = *cq_head;
+        if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) return false;
+        cqe = cqes[head & cq_mask];
+        __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    int ring_fd = -1;
+    void* sq_ptr = MAP_FAILED;
+    void* cq_ptr = MAP_FAILED;
+    void* sqes = MAP_FAILED;
+    size_t sq_size = 0, cq_size = 0, sqes_size = 0;
+
+    unsigned* sq_tail = nullptr;
+    unsigned sq_mask = 0;
+    unsigned* sq_array = nullptr;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned cq_mask = 0;
+    struct io_uring_cqe* cqes = nullptr;
+    unsigned to_submit = 0;
+};
+
+/**
+ * @brief Check if the kernel provides io_uring (it may be missing, or disabled by a seccomp filter or sysctl).
+ */
+inline bool ioUringSupported() {
+    IoUring ring;
+    return ring.init(1);
+}
+#else
+inline bool ioUringSupported() { return false; }
+#endif
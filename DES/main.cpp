@@ -1,10 +1,28 @@
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define has_mmap
+#endif
 
-#include "SBox.cpp"
+// DES engine, also built as a library on its own
+#include "des.cpp"
 
 // Define this macro to enable error messages, comment it to disable error messages
 #define show_err
@@ -14,103 +32,143 @@ using namespace std;
 // error message
 
 // usage message to be printed in case of invalid arguments
-const char usage_msg[] = "\033[31mUsage1: encrypt <plaint_text.txt> <key.txt> <cipher_tex.dat>\nUsage2: decrypt <cipher_text.dat> <key.txt> <plain_text.txt>\n\033[0m";
+const char usage_msg[] = "\033[31mUsage1: encrypt <plaint_text.txt> <key.txt> <cipher_tex.dat> [options]\nUsage2: decrypt <cipher_text.dat> <key.txt> <plain_text.txt> [options]\n"
+                         "Usage3: encrypt-ctr|decrypt-ctr <input> <key.txt> <output> --iv=<16 hex digits> [options]\n"
+                         "Usage4: encrypt-cbc|decrypt-cbc <input> <key.txt> <output> --iv=<16 hex digits> [options]\n"
+                         "Usage5: batch encrypt|decrypt|encrypt-cbc|decrypt-cbc <manifest.txt> <key.txt> [options]\n"
+                         "The manifest lists an input file and an output file per line, separated by a tab.\n"
+                         "Usage6: search <pairs.txt> <key>/<mask> <checkpoint.txt> [options]\n"
+                         "Each line of pairs.txt holds a plaintext and its ciphertext (16 hex digits each), the mask (16 hex\n"
+                         "digits) sets the known bits of the key, the other bits are searched.\n"
+                         "The key file holds 8 bytes (DES), 16 or 24 bytes (triple DES EDE with K1 K2 [K3]).\n"
+                         "Options:\n  --iv=<16 hex digits>                   initial counter block (CTR) or initialization vector (CBC)\n  --kernel=<auto|avx512|avx2|portable>  bitsliced kernel to use (default: widest supported)\n"
+                         "  --threads <n>                          number of threads (default: hardware concurrency)\n"
+                         "  --stream[=<size>[K|M|G]]               stream the files in chunks of <size> bytes (default: 4M)\n"
+                         "  --mmap                                 map the files in memory instead of reading them\n"
+                         "  --io-uring[=<size>[K|M|G]]             asynchronous I/O with io_uring in chunks of <size> bytes (default: 1M)\n"
+                         "  --stats                                print the elapsed time and throughput\n\033[0m";
 // file not opened message
 const char file_not_opened[] = "\033[31mError: File not opened\n\033[0m";
 
 // key, plaintext and ciphertext global variables
 uint64_t key;
+uint64_t ede_keys[3];        // K1, K2, K3 of triple DES, K1 is also in key
+bool is_triple_des = false;  // set by a 16 or 24-byte key file, K3 = K1 for 16 bytes
 uint64_t* data_blocks = nullptr;
 string output_file;
 bool is_encrypt;
-size_t num_blocks;
-
-// DES Tables
-// left shift table, position is the (round number - 1), value is the number of bits to shift and rotate
-const int left_shift_table[16] = {1, 1, 2, 2, 2, 2, 2, 2, 1, 2, 2, 2, 2, 2, 2, 1};
-
-//permutaion choice 1 table
-const int pc_1[56] = {  57 ,49 ,41 ,33 ,25 ,17 ,9  ,
-                        1  ,58 ,50 ,42 ,34 ,26 ,18 ,
-                        10 ,2  ,59 ,51 ,43 ,35 ,27 ,
-                        19 ,11 ,3  ,60 ,52 ,44 ,36 ,
-                        63 ,55 ,47 ,39 ,31 ,23 ,15 ,
-                        7  ,62 ,54 ,46 ,38 ,30 ,22 ,
-                        14 ,6  ,61 ,53 ,45 ,37 ,29 ,
-                        21 ,13 ,5  ,28 ,20 ,12 ,4 };
-
-
-//permutation choice 2 table
-const int pc_2[48] = {  14 ,17 ,11 ,24 ,1  ,5  ,
-                        3  ,28 ,15 ,6  ,21 ,10 ,
-                        23 ,19 ,12 ,4  ,26 ,8  ,
-                        16 ,7  ,27 ,20 ,13 ,2  ,
-                        41 ,52 ,31 ,37 ,47 ,55 ,
-                        30 ,40 ,51 ,45 ,33 ,48 ,
-                        44 ,49 ,39 ,56 ,34 ,53 ,
-                        46 ,42 ,50 ,36 ,29 ,32 };              
-
-
-// intital permutation table
-const int IP_t[64] = { 	58 ,50 ,42 ,34 ,26 ,18 ,10 ,2 ,  
-                        60 ,52 ,44 ,36 ,28 ,20 ,12 ,4 ,
-                        62 ,54 ,46 ,38 ,30 ,22 ,14 ,6 ,
-                        64 ,56 ,48 ,40 ,32 ,24 ,16 ,8 ,
-                        57 ,49 ,41 ,33 ,25 ,17 ,9  ,1 ,
-                        59 ,51 ,43 ,35 ,27 ,19 ,11 ,3 ,
-                        61 ,53 ,45 ,37 ,29 ,21 ,13 ,5 ,
-                        63 ,55 ,47 ,39 ,31 ,23 ,15 ,7 };    
-
-
-//final permutation table
-const int P_1[64] = { 	40 ,8  ,48 ,16 ,56 ,24 ,64 ,32 ,
-                        39 ,7  ,47 ,15 ,55 ,23 ,63 ,31 ,
-                        38 ,6  ,46 ,14 ,54 ,22 ,62 ,30 ,
-                        37 ,5  ,45 ,13 ,53 ,21 ,61 ,29 ,
-                        36 ,4  ,44 ,12 ,52 ,20 ,60 ,28 ,
-                        35 ,3  ,43 ,11 ,51 ,19 ,59 ,27 ,
-                        34 ,2  ,42 ,10 ,50 ,18 ,58 ,26 ,
-                        33 ,1  ,41 ,9  ,49 ,17 ,57 ,25 };
-              
-
-
- // expantion table
-const int E_t[48] = { 	32 ,1  ,2  ,3  ,4  ,5  ,
-                        4  ,5  ,6  ,7  ,8  ,9  ,
-                        8  ,9  ,10 ,11 ,12 ,13 ,
-                        12 ,13 ,14 ,15 ,16 ,17 ,
-                        16 ,17 ,18 ,19 ,20 ,21 ,
-                        20 ,21 ,22 ,23 ,24 ,25 ,
-                        24 ,25 ,26 ,27 ,28 ,29 ,
-                        28 ,29 ,30 ,31 ,32 ,1 };
-
-
-// permutation table
-const int P[32] = { 	16 ,7  ,20 ,21 ,
-                        29 ,12 ,28 ,17 ,
-                        1  ,15 ,23 ,26 ,
-                        5  ,18 ,31 ,10 ,
-                        2  ,8  ,24 ,14 ,
-                        32 ,27 ,3  ,9  ,
-                        19 ,13 ,30 ,6  ,
-                        22 ,11 ,4  ,25 };
-
+size_t num_blocks;  // blocks of data_blocks, the last one may be partial in CTR mode
+size_t data_size;   // bytes of data, a multiple of 8 in ECB mode
+
+// mode of operation: ECB (encrypt, decrypt), CTR (encrypt-ctr, decrypt-ctr) or CBC (encrypt-cbc, decrypt-cbc)
+enum CipherMode { MODE_ECB, MODE_CTR, MODE_CBC };
+const char* const cipher_mode_names[] = {"ECB", "CTR", "CBC"};
+CipherMode cipher_mode = MODE_ECB;
+
+// initial counter block of the CTR mode, block i of the data is XORed with E(iv + i),
+// or initialization vector of the CBC mode, XORed with the first plaintext block
+uint64_t iv;
+bool has_iv = false;
+
+// I/O and threading of the command line tool
+#include "thread_pool.cpp"
+#include "spsc_ring.cpp"
+#include "io_uring.cpp"
+
+// known-plaintext key search of the search subcommand
+#include "search.cpp"
+
+// options
+string kernel_name = "auto";                    // --kernel=
+const BitsliceKernel* bitslice_kernel = nullptr; // kernel selected from kernel_name
+unsigned num_threads = 0;                        // --threads, 0 for the hardware concurrency
+size_t stream_chunk_size = 0;                    // --stream, bytes per chunk, 0 to load the whole file
+bool use_mmap = false;                           // --mmap
+size_t uring_chunk_size = 0;                     // --io-uring, bytes per transfer, 0 to disable
+bool show_stats = false;                         // --stats
+bool is_batch = false;                           // batch <operation> <manifest> <key>
+bool is_search = false;                          // search <pairs> <key>/<mask> <checkpoint>
+
+// worker threads, started once the options are known
+std::unique_ptr<ThreadPool> thread_pool;
+
+// number of blocks per task in multi-threaded mode: 256 KiB, a multiple of every kernel batch
+const size_t chunk_blocks = 32768;
+
+// default chunk size of --stream and number of chunk buffers in flight
+const size_t default_stream_chunk_size = 4 << 20;
+const int stream_buffers = 4;
+
+// default transfer size of --io-uring and number of registered buffers in flight
+const size_t default_uring_chunk_size = 1 << 20;
+const int uring_buffers = 8;
+
+// bytes per task of the batch mode, a multiple of chunk_blocks blocks
+const size_t batch_chunk_size = 4 << 20;
+
+// CBC encryption of the batch mode: files per task, a batch of the widest kernel, and bytes of each file
+// encrypted per step
+const size_t batch_cbc_group_files = 512;
+const size_t batch_cbc_chunk_size = 16 << 10;
+
+// keys per task of the search subcommand, and seconds between two checkpoints
+const uint64_t search_unit_keys = uint64_t(1) << 24;
+const double search_checkpoint_seconds = 10;
+
+// a file of the batch mode, shared by the tasks of its chunks
+struct BatchFile {
+    string input_file;
+    string output_file;
+    uint64_t file_size = 0;  // bytes of the input file
+    uint64_t size = 0;       // bytes of data, see dataSize()
+    uint64_t chain = 0;      // CBC encryption chain: the IV, then the last ciphertext block
+    std::atomic<size_t> remaining{0};           // chunk tasks not finished
+    std::atomic<const char*> error{nullptr};    // first error, the other chunks are skipped
+    std::atomic<uint64_t> cipher_nanoseconds{0};
+    std::chrono::steady_clock::time_point start, end;
+};
+
+// statistics reported by --stats
+const char* io_path = "read";  // I/O path that processed the files
+double cipher_seconds = 0;     // time spent in the kernels, accumulated by runChunks()
 
 
 
 
 // functions definitions
+
 /**
  * @brief Validate the arguments passed to the program.
  *
- * @param argc Number of arguments passed to the program.
- * @param argv Array of arguments passed to the program.
+ * @param argc Number of arguments passed to the program, set to the number of positional arguments.
+ * @param argv Array of arguments passed to the program, the options are removed from it.
  * @return true if the arguments are valid, false otherwise.
  *
- * The function checks if the number of arguments is correct (5) and if the first argument is "encrypt" or "decrypt".
+ * The function parses and removes the options (arguments starting with "--", with their value either
+ * after '=' or as the next argument for --threads),
+ * then checks if the number of remaining arguments is correct (5) and if the first argument is "encrypt" or "decrypt",
+ * or "batch" followed by one of them, or "search".
+ * It selects the bitsliced kernel to use and the mode of operation, CTR requires --iv.
+ *
+ */
+bool validateArgs(int& argc, char* argv[]);
+
+/**
+ * @brief Parse a size with an optional K, M or G suffix.
  *
+ * @param value The size, e.g. "65536" or "4M".
+ * @param size The parsed size in bytes.
+ * @return true if the size is valid, false otherwise.
  */
-bool validateArgs(int argc, char* argv[]);
+bool parseSize(const string& value, size_t& size);
+
+/**
+ * @brief Parse a single option passed to the program.
+ *
+ * @param option The option, in the form --name=value.
+ * @return true if the option is known and its value is valid, false otherwise.
+ */
+bool parseOption(const string& option);
 
 /**
  * @brief Open and read the files passed as arguments to the program.
@@ -130,156 +188,365 @@ bool validateArgs(int argc, char* argv[]);
 bool openFiles(char* argv[]);
 
 /**
- * @brief Write the output file.
+ * @brief Read the key file into the global key variables.
  *
- * @return true if the output file is written successfully, false otherwise.
+ * @param key_file Path of the key file.
+ * @return true if the key file is opened and contains 8 bytes (DES), 16 or 24 bytes (triple DES), false otherwise.
+ */
+bool readKeyFile(const string& key_file);
+
+/**
+ * @brief Encrypt or decrypt the input file into the output file through a streaming pipeline.
  *
- * The function writes the output file based on the mode of the operation.
- * If the mode is "encrypt", it writes the ciphertext to the output file.
- * If the mode is "decrypt", it writes the plaintext to the output file.
- * It deletes the plaintext and ciphertext arrays after writing the output file.
+ * @param argv Array of arguments passed to the program.
+ * @return true if the files are processed successfully, false otherwise.
+ *
+ * A reader thread, the calling thread (cipher, using the thread pool) and a writer thread work on
+ * stream_buffers chunks of stream_chunk_size bytes, handed over through lock-free SPSC rings,
+ * so memory use does not depend on the file size and disk I/O overlaps with the computation.
+ * The output is the same as with openFiles(), processData() and writeOutputFile().
  */
-bool writeOutputFile();
+bool streamFiles(char* argv[]);
 
 /**
- * @brief Swap the endianness of a 64-bit integer  (little-endian to big-endian only).
+ * @brief Encrypt or decrypt the input file into the output file through memory mappings.
  *
- * @note The function uses the GCC built-in function __builtin_bswap64 to swap the endianness of the 64-bit integer.
- * @note The function is only used for little-endian systems, otherwise, it returns the same value.
+ * @param argv Array of arguments passed to the program.
+ * @return true if the files are processed successfully, false otherwise.
  *
- * @param value 64-bit integer to swap its endianness.
- * @return 64-bit integer with big endianness.
+ * The input file is mapped read-only and the output file is created with its final size and mapped
+ * read-write. Each chunk of blocks is loaded from the input mapping, processed and stored into the
+ * output mapping by the thread pool, without reading the files into a heap buffer.
+ * Only available on POSIX systems.
  */
-inline uint64_t swapEndianness(uint64_t value);
+bool mapFiles(char* argv[]);
 
 /**
- * @brief Swap the endianness of a 64-bit integer array, only to be used for little-endian systems.
+ * @brief Encrypt or decrypt the input file into the output file with asynchronous io_uring transfers.
  *
- * @param arr 64-bit integer array to swap its endianness.
+ * @param argv Array of arguments passed to the program.
+ * @return true if the files are processed successfully, false otherwise.
  *
- * The function swaps the endianness of each element in the array.
- * It uses the swapEndiannesss function to swap the endianness of each element to big-endian.
- * @note The function modifies the array in place.
- * @note The size of the arr is file_size / 8.
+ * uring_buffers buffers of uring_chunk_size bytes are registered with the ring and kept in flight: each
+ * buffer is read at its offset, processed by the thread pool as soon as its read completes and written
+ * back at the same offset, then reused for the next chunk. Reads and writes of the other buffers
+ * proceed in the kernel meanwhile. Unregistered buffers are used if registration fails.
+ * Only available on Linux, main() falls back to the default path when the kernel has no io_uring.
  */
-void swapEndiannessForArray(uint64_t* arr);
+bool uringFiles(char* argv[]);
 
 /**
- * @brief Check if the system is little-endian.
+ * @brief Encrypt or decrypt every file listed in a manifest in one process.
+ *
+ * @param argv Array of arguments passed to the program: batch, the operation, the manifest and the key file.
+ * @return true if every file is processed successfully, false otherwise.
  *
- * @return true if the system is little-endian, false otherwise.
+ * Each line of the manifest holds an input and an output path separated by a tab (or by the first space),
+ * empty lines and lines starting with '#' are skipped. A task per file creates its output and splits it
+ * into tasks of batch_chunk_size bytes on the thread pool, so the threads that are done with the small
+ * files steal the chunks of the large ones. A CBC chain cannot be split, so the CBC encryption runs a task
+ * per group of files instead, which encrypts its files together. The throughput of every file and of the
+ * whole batch is printed to the standard output. Only available on POSIX systems.
  */
-inline bool isLittleEndian();
+bool batchFiles(char* argv[]);
 
+#ifdef has_mmap
 /**
- * @brief Process the data based on the mode of the operation.
+ * @brief Open a file of the batch mode and create its output with its final size.
  *
- * The function performs the encryption or decryption based on the mode of the operation.
- * It uses the DES algorithm to encrypt or decrypt the data.
+ * @param file The file, its paths are set. Its start time and sizes are set, or its error.
+ * @param input_fd Set to the descriptor of the input file.
+ * @param output_fd Set to the descriptor of the output file.
+ * @return true if both files are open, false if the file failed, no descriptor is left open then.
  */
-void processData();
+bool openBatchFile(BatchFile& file, int& input_fd, int& output_fd);
 
+/**
+ * @brief Open a file of the batch mode, create its output and run or queue the tasks of its chunks.
+ *
+ * @param file The file, its paths are set.
+ * @param context The key, prepared for the kernels.
+ *
+ * The first chunk is run by the calling task.
+ */
+void startBatchFile(BatchFile& file, const DesContext& context);
 
 /**
- * @brief converts the input key string to into binary representation
- * 
- * @param inputKey 
- * @param key 
+ * @brief Encrypt a group of files of the batch mode in CBC mode, together.
+ *
+ * @param files The files, their paths are set.
+ * @param count Number of files.
+ * @param context The key, prepared for the kernels.
+ *
+ * Each step reads the next batch_cbc_chunk_size bytes of every unfinished file, encrypts them as one
+ * chain per file with DesContext::cbc_encrypt_streams(), so that the block of every chain goes through
+ * the same kernel call, and writes them back. A file that fails is dropped from the group.
  */
-void convertHexKeyIntoBinary(unsigned char *inputKey, uint64_t key);
+void encryptBatchCbcGroup(BatchFile* files, size_t count, const DesContext& context);
 
+/**
+ * @brief Read, process and write a chunk of a file of the batch mode.
+ *
+ * @param file The file.
+ * @param input_fd Descriptor of the input file.
+ * @param output_fd Descriptor of the output file, created with its final size.
+ * @param offset Position of the chunk in the data, a multiple of batch_chunk_size.
+ * @param context The key, prepared for the kernels.
+ *
+ * Nothing is done if the file already failed. The last chunk to finish sets the end time of the file.
+ */
+void runBatchChunk(BatchFile& file, int input_fd, int output_fd, uint64_t offset, const DesContext& context);
 
 /**
- * @brief General permutation function for DES.
+ * @brief Record the first error of a file of the batch mode.
+ */
+void failBatchFile(BatchFile& file, const char* error);
+
+/**
+ * @brief Read or write size bytes at an offset of a file, retrying the short transfers.
  *
- * @param input The input data to permute.
- * @param table The permutation table defining the new bit order.
- * @param table_size The number of bits to permute.
- * @param total_bits The total number of bits in the input.
- * @return The permuted output data.
+ * @return true if all the bytes are transferred, false on an error or at the end of the file.
  */
-uint64_t permute(uint64_t input, const int* table, int table_size, int total_bits) {
-    uint64_t output = 0;
-    for(int i = 0; i < table_size; i++) {
-        output <<= 1;
-        // Extract the bit from the input based on the table
-        output |= (input >> (total_bits - table[i])) & 0x01;
-    }
-    return output;
-}
+bool preadFully(int fd, void* buffer, size_t size, uint64_t offset);
+bool pwriteFully(int fd, const void* buffer, size_t size, uint64_t offset);
+#endif
 
+/**
+ * @brief Search the DES key of known plaintext and ciphertext pairs.
+ *
+ * @param argv Array of arguments passed to the program: search, the pairs file, the key space and the checkpoint file.
+ * @return true if a key matching every pair is found, false otherwise.
+ *
+ * The key space is <key>/<mask> in hex: the bits set in the mask are known and taken from the key, the others
+ * are enumerated, except the parity bits. The space is split into tasks of search_unit_keys keys, run by all the
+ * threads with the bitsliced search kernel on the first pair in Gray-code order of the batches, and the candidates are verified on every pair. The
+ * search stops at the first key matching every pair and prints it with odd parity, then the keys per second per core.
+ * The tasks done in order are saved to the checkpoint file every search_checkpoint_seconds and at the end, a run
+ * with the same key space and first pair resumes from it.
+ */
+bool searchKeys(char* argv[]);
 
+/**
+ * @brief Read the checkpoint file of a search.
+ *
+ * @param checkpoint_file Path of the checkpoint file, the search starts from the beginning if it does not exist.
+ * @param search_id First line of the checkpoint, identifies the key space and the first pair.
+ * @param next_unit Set to the first task not done.
+ * @param found Set to true if the key was already found.
+ * @param key Set to the key found.
+ * @return true on success, false if the checkpoint is invalid or belongs to another search.
+ */
+bool readSearchCheckpoint(const string& checkpoint_file, const string& search_id, uint64_t& next_unit, bool& found, uint64_t& key);
 
+/**
+ * @brief Write the checkpoint file of a search, through a temporary file renamed over it.
+ *
+ * @return true on success, false if the file could not be written.
+ */
+bool writeSearchCheckpoint(const string& checkpoint_file, const string& search_id, uint64_t next_unit, bool found, uint64_t key);
 
+/**
+ * @brief Parse 16 hex digits.
+ *
+ * @return true if the text is exactly 16 hex digits, false otherwise.
+ */
+bool parseHex64(const string& text, uint64_t& value);
 
 /**
- * @brief Generate all the 16 rounds 56-bit keys based on the key value (global 64 bit variable).
+ * @brief Format a 64-bit value as 16 hex digits.
+ */
+string toHex64(uint64_t value);
+
+/**
+ * @brief Set the parity bit of every byte of a key so that each byte has an odd number of bits set.
+ */
+uint64_t withOddParity(uint64_t key);
+
+/**
+ * @brief Print the I/O path, the elapsed time and the throughput of the run to the standard error.
+ *
+ * @param seconds Elapsed time of the run.
+ */
+void reportStats(double seconds);
+
+/**
+ * @brief Size of the data processed from an input file of a given size.
+ *
+ * @param file_size Size of the input file in bytes.
+ * @return file_size in CTR mode, file_size without the trailing bytes that do not fill a block in ECB mode.
+ */
+uint64_t dataSize(uint64_t file_size);
+
+/**
+ * @brief Length of the PKCS#7 padding at the end of CBC decrypted data.
+ *
+ * @param end End of the data.
+ * @return The number of padding bytes, 1 to 8, or 0 if the padding is invalid.
+ */
+unsigned paddingLength(const unsigned char* end);
+
+/**
+ * @brief Write the output file.
+ *
+ * @return true if the output file is written successfully, false otherwise.
+ *
+ * The function writes the output file based on the mode of the operation.
+ * If the mode is "encrypt", it writes the ciphertext to the output file.
+ * If the mode is "decrypt", it writes the plaintext to the output file.
+ * It deletes the plaintext and ciphertext arrays after writing the output file.
+ */
+bool writeOutputFile();
+
+
+/**
+ * @brief Run the mode of the operation over a range of the data.
  *
- * @param keys Array of 16 64-bit integers to store the generated keys.
+ * @param input Data to process, as stored in the files.
+ * @param output Where to store the result, may be the same as input.
+ * @param size Number of bytes, a multiple of 8 except at the end of the data in CTR mode.
+ * @param first_block Index of the first block in the data, it sets the counter in CTR mode.
+ * @param context The key, prepared for the kernels.
  *
- * The function generates the keys based on the key value.
- * @note The function modifies the keys array in place.
- * @note The size of the keys array is 16.
- * @note The function modifies the order of keys in Decryption mode.
+ * In ECB mode the blocks are encrypted or decrypted by the context, in CTR mode they are XORed with the keystream.
  */
-void keyGeneration(uint64_t* keys);
+void processRange(const uint64_t* input, uint64_t* output, size_t size, uint64_t first_block, const DesContext& context);
 
 /**
- * @brief Perform the left shift and rotate operation on a 28-bit key at a specific round based on the left shift table in DES algorithm.
+ * @brief Run the mode of the operation over a range of the data with all the threads of the pool.
  *
- * @param value 32-bit integer to perform the left shift and rotate operation on.
- * @param round The round number to determine the number of bits to shift and rotate.
- * @return 32-bit integer after performing the left shift and rotate operation.
+ * Same parameters as processRange(). With more than one thread, the data is split into tasks of chunk_blocks
+ * blocks run by the thread pool.
+ */
+void processRangeParallel(const uint64_t* input, uint64_t* output, size_t size, uint64_t first_block, const DesContext& context);
+
+
+/**
+ * @brief Run a function over a range of blocks split into tasks of chunk_blocks blocks on the thread pool.
  *
- * The function performs the left shift and rotate operation on a 32-bit integer.
- * The number of bits to shift and rotate is determined by the round number.
+ * @param count Number of blocks.
+ * @param process Function called as process(first, count) on each task, possibly from several threads.
  */
-inline uint32_t leftShiftRotate(uint32_t value, int round);
+template <typename F>
+void runChunks(size_t count, F process);
 
 /**
- * @brief Perform the DES algorithm on a 64-bit block using the generated keys.
+ * @brief Expand the global key and prepare it for the selected kernel, in both directions.
  *
- * @param block 64-bit block to perform the DES algorithm on.
- * @param keys Array of 16 64-bit integers to use in the DES algorithm.
- * @return 64-bit block after performing the DES algorithm.
+ * @return The context shared read-only by all the threads.
  *
+ * With a triple DES key, the three schedules are generated once and chained: E(K1) D(K2) E(K3) to encrypt,
+ * D(K3) E(K2) D(K1) to decrypt.
  */
-uint64_t DES(const uint64_t& block, const uint64_t* keys);
+DesContext createContext();
+
 
 /**
- * @brief Perform a single round of the DES algorithm on a 32-bit right half of the block.
+ * @brief Decrypt CBC blocks in place with all the threads of the pool.
+ *
+ * @param blocks Ciphertext blocks as stored in the files, replaced by the plaintext.
+ * @param count Number of blocks.
+ * @param context The key, prepared for the kernels.
+ *
+ * Each plaintext block only depends on two ciphertext blocks, so the blocks are decrypted in parallel by
+ * the multi-block kernels. The ciphertext block preceding each task is saved before the tasks start.
+ */
+void cbcDecryptParallel(uint64_t* blocks, size_t count, const DesContext& context);
+
+/**
+ * @brief Value of a block as stored in the files (big-endian), e.g. the CBC chain preceding a range.
+ */
+uint64_t blockValue(const uint8_t* bytes);
+
+
+/**
+ * @brief Process the data based on the mode of the operation.
  *
- * @param r 32-bit right half of the block to perform the DES round on.
- * @param key 48-bit key to use in the DES round.
- * @return 32-bit right half of the block after performing the DES round (right half operaions only).
+ * @return true on success, false if the padding of CBC decrypted data is invalid.
  *
+ * The function generates the key schedule once and performs the encryption or decryption based on the
+ * mode of the operation, the mode is not checked again for each block.
  */
-inline uint64_t DES_round(uint64_t r, const uint64_t& key);
+bool processData();
+
 
 int main(int argc, char* argv[]) {
+    // Build the permutation lookup tables
+    initPermutationTables();
+
     // Check if the arguments are valid
     if (!validateArgs(argc, argv)) {
         return 1;
     }
 
-    // Open and load needed files
-    if (!openFiles(argv)) {
-        delete[] data_blocks;
-        return 1;
+    // Start the worker threads
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
     }
+    thread_pool.reset(new ThreadPool(num_threads));
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Stream the files in chunks, map them or use io_uring if requested
+    bool ok;
+    if (is_search) {
+        ok = searchKeys(argv);
+    } else if (is_batch) {
+        ok = batchFiles(argv);
+    } else if (stream_chunk_size > 0) {
+        ok = streamFiles(argv);
+    } else if (use_mmap) {
+        ok = mapFiles(argv);
+    } else if (uring_chunk_size > 0 && ioUringSupported()) {
+        ok = uringFiles(argv);
+    } else {
+#ifdef show_err
+        if (uring_chunk_size > 0) {
+            cerr << "\033[33mWarning: io_uring is not available, using the default path\n\033[0m";
+        }
+#endif
+        // Open and load needed files
+        if (!openFiles(argv)) {
+            delete[] data_blocks;
+            return 1;
+        }
 
-    // Perform the encryption or decryption
-    processData();
+        // Perform the encryption or decryption, then write the output file
+        ok = processData() && writeOutputFile();
+        if (!ok) {
+            delete[] data_blocks;
+        }
+    }
 
-    // Write the output file
-    if (!writeOutputFile()) {
-        delete[] data_blocks;
-        return 1;
+    if (ok && show_stats && !is_search) {
+        reportStats(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
     }
-    return 0;
+    return ok ? 0 : 1;
 }
 
-bool validateArgs(int argc, char* argv[]) {
+
+bool validateArgs(int& argc, char* argv[]) {
+    // Parse the options and keep the positional arguments in place
+    int num_positional = 0;
+    for (int i = 0; i < argc; i++) {
+        string arg = argv[i];
+        if (i > 0 && arg.rfind("--", 0) == 0) {
+            // options taking a value also accept it as the next argument
+            if (arg == "--threads" && i + 1 < argc) {
+                arg += string("=") + argv[++i];
+            }
+
+            if (!parseOption(arg)) {
+#ifdef show_err
+                cerr << usage_msg;
+#endif
+                return false;
+            }
+            continue;
+        }
+        argv[num_positional++] = argv[i];
+    }
+    argc = num_positional;
+
     // Check if the number of arguments is correct
     if (argc != 5) {
 #ifdef show_err
@@ -288,11 +555,34 @@ bool validateArgs(int argc, char* argv[]) {
         return false;  // Return immediately on error
     }
 
-    // Cache the arguments as strings
-    string mode = argv[1];
+    // Select the bitsliced kernel
+    bitslice_kernel = selectBitsliceKernel(kernel_name.c_str());
+    if (bitslice_kernel == nullptr) {
+#ifdef show_err
+        cerr << "\033[31mError: Kernel " << kernel_name << " is unknown or not supported by this CPU\n\033[0m";
+#endif
+        return false;
+    }
 
-    // Check if the first argument is "encrypt" or "decrypt"
-    if (mode != "encrypt" && mode != "decrypt") {
+    // the search subcommand has no operation and no I/O options
+    is_search = (string(argv[1]) == "search");
+    if (is_search) {
+        if (has_iv || stream_chunk_size > 0 || use_mmap || uring_chunk_size > 0) {
+#ifdef show_err
+            cerr << "\033[31mError: --iv, --stream, --mmap and --io-uring are not used by search\n\033[0m";
+#endif
+            return false;
+        }
+        return true;
+    }
+
+    // Cache the arguments as strings, the batch mode takes the operation as second argument
+    is_batch = (string(argv[1]) == "batch");
+    string mode = is_batch ? argv[2] : argv[1];
+
+    // Check if the first argument is "encrypt" or "decrypt", optionally with the CTR or CBC mode
+    if (mode != "encrypt" && mode != "decrypt" && mode != "encrypt-ctr" && mode != "decrypt-ctr" &&
+        mode != "encrypt-cbc" && mode != "decrypt-cbc") {
 #ifdef show_err
         cerr << usage_msg;
 #endif
@@ -300,11 +590,104 @@ bool validateArgs(int argc, char* argv[]) {
     }
 
     // mode assingment
-    is_encrypt = (mode == "encrypt");
+    is_encrypt = (mode.rfind("encrypt", 0) == 0);
+    string suffix = mode.substr(mode.find('-') == string::npos ? mode.size() : mode.find('-'));
+    cipher_mode = (suffix == "-ctr") ? MODE_CTR : (suffix == "-cbc") ? MODE_CBC : MODE_ECB;
+    if ((cipher_mode != MODE_ECB) != has_iv) {
+#ifdef show_err
+        cerr << "\033[31mError: --iv is required by the CTR and CBC modes and only used by them\n\033[0m";
+#endif
+        return false;
+    }
+
+    // a single counter would encrypt every file of a batch with the same keystream
+    if (is_batch && (cipher_mode == MODE_CTR || stream_chunk_size > 0 || use_mmap || uring_chunk_size > 0)) {
+#ifdef show_err
+        cerr << "\033[31mError: The CTR mode, --stream, --mmap and --io-uring are not supported in batch mode\n\033[0m";
+#endif
+        return false;
+    }
+
+    // the padding changes the size of the data, the CBC mode only loads the whole file
+    if (cipher_mode == MODE_CBC && (stream_chunk_size > 0 || use_mmap || uring_chunk_size > 0)) {
+#ifdef show_err
+        cerr << "\033[31mError: --stream, --mmap and --io-uring are not supported in CBC mode\n\033[0m";
+#endif
+        return false;
+    }
 
     return true;  // Return true if all checks pass
 }
 
+bool parseOption(const string& option) {
+    size_t eq = option.find('=');
+    string name = option.substr(0, eq);
+    string value = (eq == string::npos) ? "" : option.substr(eq + 1);
+
+    if (name == "--kernel" && !value.empty()) {
+        kernel_name = value;
+        return true;
+    }
+    if (name == "--threads" && !value.empty() && value.find_first_not_of("0123456789") == string::npos) {
+        num_threads = stoul(value);
+        return num_threads > 0;
+    }
+    if (name == "--mmap" && eq == string::npos) {
+#ifdef has_mmap
+        use_mmap = true;
+        return true;
+#else
+        return false;
+#endif
+    }
+    if (name == "--iv" && value.size() == 16 && value.find_first_not_of("0123456789abcdefABCDEF") == string::npos) {
+        iv = stoull(value, nullptr, 16);
+        has_iv = true;
+        return true;
+    }
+    if (name == "--stats" && eq == string::npos) {
+        show_stats = true;
+        return true;
+    }
+    if (name == "--io-uring") {
+#ifdef has_io_uring
+        if (eq == string::npos) {
+            uring_chunk_size = default_uring_chunk_size;
+            return true;
+        }
+        // whole blocks only, the length of a transfer is 32 bits
+        return parseSize(value, uring_chunk_size) && (uring_chunk_size -= uring_chunk_size % 8) > 0 &&
+               uring_chunk_size <= (1u << 30);
+#else
+        return false;
+#endif
+    }
+    if (name == "--stream") {
+        if (eq == string::npos) {
+            stream_chunk_size = default_stream_chunk_size;
+            return true;
+        }
+        // whole blocks only
+        return parseSize(value, stream_chunk_size) && (stream_chunk_size -= stream_chunk_size % 8) > 0;
+    }
+    return false;
+}
+
+bool parseSize(const string& value, size_t& size) {
+    size_t digits = value.find_first_not_of("0123456789");
+    if (digits == 0 || value.empty()) return false;
+
+    size = stoull(value.substr(0, digits));
+    if (digits == string::npos) return true;
+
+    string suffix = value.substr(digits);
+    if (suffix == "K" || suffix == "k") size <<= 10;
+    else if (suffix == "M" || suffix == "m") size <<= 20;
+    else if (suffix == "G" || suffix == "g") size <<= 30;
+    else return false;
+    return true;
+}
+
 bool openFiles(char* argv[]) {
     string input_file = argv[2];
     string key_file = argv[3];
@@ -319,56 +702,95 @@ bool openFiles(char* argv[]) {
         return false;
     }
 
-    // open the key file and check if it is opened
-    ifstream key_file_stream(key_file, ios::binary | ios::ate);
-    if (!key_file_stream.is_open()) {
+    // input file processing
+
+    streampos file_size = input_file_stream.tellg();
+    data_size = dataSize(file_size);
+    num_blocks = (data_size + 7) / 8;
+
+    if (cipher_mode == MODE_CBC && !is_encrypt && (data_size != static_cast<size_t>(file_size) || data_size == 0)) {
 #ifdef show_err
-        cerr << file_not_opened << "Key file\n";
+        cerr << "\033[31mError: CBC ciphertext must be a non-empty multiple of eight bytes\n\033[0m";
 #endif
         return false;
     }
 
-    // input file processing
-
-    streampos file_size = input_file_stream.tellg();
-    num_blocks = file_size / 8;
-
     data_blocks = new uint64_t[num_blocks];
 
+    // trailing bytes that do not fill a block are not read in ECB mode
+    size_t read_size = std::min<size_t>(data_size, file_size);
     input_file_stream.seekg(0, ios::beg);
-    input_file_stream.read(reinterpret_cast<char*>(data_blocks), file_size);
+    input_file_stream.read(reinterpret_cast<char*>(data_blocks), read_size);
     input_file_stream.close();
 
-    // Swap endianness if needed
-    swapEndiannessForArray(data_blocks);
+    // PKCS#7 padding: n bytes of value n
+    if (cipher_mode == MODE_CBC && is_encrypt) {
+        unsigned char* padding = reinterpret_cast<unsigned char*>(data_blocks) + read_size;
+        memset(padding, static_cast<int>(data_size - read_size), data_size - read_size);
+    }
+
+    // the blocks stay in file order, the kernels load and store them big-endian
 
     // key file processing
+    return readKeyFile(key_file);
+}
+
+bool readKeyFile(const string& key_file) {
+    // open the key file and check if it is opened
+    ifstream key_file_stream(key_file, ios::binary | ios::ate);
+    if (!key_file_stream.is_open()) {
+#ifdef show_err
+        cerr << file_not_opened << "Key file\n";
+#endif
+        return false;
+    }
+
     size_t key_size = key_file_stream.tellg();
 
-    if (key_size != 8) {
+    if (key_size != 8 && key_size != 16 && key_size != 24) {
 #ifdef show_err
-        cerr << "\033[31mError: Key file must contain exactly eight bytes.\033[0m\n";
+        cerr << "\033[31mError: Key file must contain eight bytes, or 16 or 24 bytes for triple DES.\033[0m\n";
 #endif
 
         return false;
     }
 
     key_file_stream.seekg(0, ios::beg);
-    key_file_stream.read(reinterpret_cast<char*>(&key), 8);
+    key_file_stream.read(reinterpret_cast<char*>(ede_keys), key_size);
     key_file_stream.close();
 
-    // Swap endianness if needed
-    key = swapEndianness(key);
+    // Swap endianness if needed, keying option 2 reuses K1 as K3
+    for (size_t i = 0; i < key_size / 8; i++) {
+        ede_keys[i] = swapEndianness(ede_keys[i]);
+    }
+    if (key_size == 16) {
+        ede_keys[2] = ede_keys[0];
+    }
+    key = ede_keys[0];
+    is_triple_des = key_size > 8;
 
     return true;
 }
 
-bool writeOutputFile() {
-    // Swap endianness back if needed
-    swapEndiannessForArray(data_blocks);
+bool streamFiles(char* argv[]) {
+    string input_file = argv[2];
+    string key_file = argv[3];
+    output_file = argv[4];
 
-    // check if output file exists
-    ofstream output_file_stream = ofstream(output_file, ios::binary | ios::trunc);
+    // open the input file and check if it is opened
+    ifstream input_file_stream(input_file, ios::binary);
+    if (!input_file_stream.is_open()) {
+#ifdef show_err
+        cerr << file_not_opened << "Input file\n";
+#endif
+        return false;
+    }
+
+    if (!readKeyFile(key_file)) {
+        return false;
+    }
+
+    ofstream output_file_stream(output_file, ios::binary | ios::trunc);
     if (!output_file_stream.is_open()) {
 #ifdef show_err
         cerr << file_not_opened << "Output file\n";
@@ -376,136 +798,1001 @@ bool writeOutputFile() {
         return false;
     }
 
-    // write the data to the output file
-    output_file_stream.write(reinterpret_cast<char*>(data_blocks), num_blocks * 8);
+    DesContext context = createContext();
+    io_path = "stream";
+    data_size = 0;
+
+    // a chunk in flight, size is 0 at the end of the stream
+    struct StreamChunk {
+        uint64_t* blocks;
+        size_t size;  // bytes, only the last chunk may end with a partial block
+    };
+
+    const size_t chunk_size_blocks = stream_chunk_size / 8;
+    uint64_t* buffers = new uint64_t[stream_buffers * chunk_size_blocks];
+
+    // free buffers go back to the reader, read chunks to the cipher stage, processed chunks to the writer
+    SpscRing<StreamChunk, stream_buffers> free_ring, read_ring, done_ring;
+    for (int b = 0; b < stream_buffers; b++) {
+        free_ring.push({buffers + b * chunk_size_blocks, 0});
+    }
+
+    std::thread reader([&] {
+        while (true) {
+            StreamChunk chunk = free_ring.pop();
+            input_file_stream.read(reinterpret_cast<char*>(chunk.blocks), chunk_size_blocks * 8);
+
+            // trailing bytes that do not fill a block are dropped in ECB mode
+            chunk.size = dataSize(input_file_stream.gcount());
+            if (chunk.size > 0) {
+                read_ring.push(chunk);
+            }
+            if (chunk.size < chunk_size_blocks * 8) break;
+        }
+        read_ring.push({nullptr, 0});
+    });
+
+    std::thread writer([&] {
+        while (true) {
+            StreamChunk chunk = done_ring.pop();
+            if (chunk.size == 0) break;
+
+            output_file_stream.write(reinterpret_cast<char*>(chunk.blocks), chunk.size);
+            free_ring.push(chunk);
+        }
+    });
+
+    // cipher stage, the chunks arrive in file order
+    while (true) {
+        StreamChunk chunk = read_ring.pop();
+        if (chunk.size > 0) {
+            processRangeParallel(chunk.blocks, chunk.blocks, chunk.size, data_size / 8, context);
+            data_size += chunk.size;
+        }
+        done_ring.push(chunk);
+        if (chunk.size == 0) break;
+    }
+
+    reader.join();
+    writer.join();
+    delete[] buffers;
+
     output_file_stream.close();
+    if (!output_file_stream) {
+#ifdef show_err
+        cerr << "\033[31mError: Output file could not be written\n\033[0m";
+#endif
+        return false;
+    }
+    return true;
+}
 
-    delete[] data_blocks;
+bool mapFiles(char* argv[]) {
+#ifdef has_mmap
+    string input_file = argv[2];
+    string key_file = argv[3];
+    output_file = argv[4];
 
+    // open the input file and check if it is opened
+    int input_fd = open(input_file.c_str(), O_RDONLY);
+    if (input_fd < 0) {
+#ifdef show_err
+        cerr << file_not_opened << "Input file\n";
+#endif
+        return false;
+    }
+
+    if (!readKeyFile(key_file)) {
+        close(input_fd);
+        return false;
+    }
+
+    // create the output file with its final size, trailing bytes that do not fill a block are dropped in ECB mode
+    struct stat input_stat;
+    if (fstat(input_fd, &input_stat) != 0) {
+#ifdef show_err
+        cerr << "\033[31mError: Input file size could not be read\n\033[0m";
+#endif
+        close(input_fd);
+        return false;
+    }
+    size_t size = dataSize(input_stat.st_size);
+    io_path = "mmap";
+    data_size = size;
+
+    int output_fd = open(output_file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (output_fd < 0 || ftruncate(output_fd, size) != 0) {
+#ifdef show_err
+        cerr << file_not_opened << "Output file\n";
+#endif
+        close(input_fd);
+        if (output_fd >= 0) close(output_fd);
+        return false;
+    }
+
+    bool ok = true;
+    if (size > 0) {
+        void* input_map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, input_fd, 0);
+        void* output_map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, output_fd, 0);
+        ok = (input_map != MAP_FAILED) && (output_map != MAP_FAILED);
+
+        if (ok) {
+            // both mappings are walked once from start to end
+            madvise(input_map, size, MADV_SEQUENTIAL);
+            madvise(output_map, size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+            madvise(input_map, size, MADV_HUGEPAGE);
+            madvise(output_map, size, MADV_HUGEPAGE);
+#endif
+
+            DesContext context = createContext();
+
+            const uint64_t* input = static_cast<const uint64_t*>(input_map);
+            uint64_t* output = static_cast<uint64_t*>(output_map);
+            processRangeParallel(input, output, size, 0, context);
+        }
+#ifdef show_err
+        else {
+            cerr << "\033[31mError: Files could not be mapped\n\033[0m";
+        }
+#endif
+
+        if (input_map != MAP_FAILED) munmap(input_map, size);
+        if (output_map != MAP_FAILED) munmap(output_map, size);
+    }
+
+    close(input_fd);
+    ok = (close(output_fd) == 0) && ok;
+    return ok;
+#else
+    (void)argv;
+    return false;
+#endif
+}
+
+bool uringFiles(char* argv[]) {
+#ifdef has_io_uring
+    string input_file = argv[2];
+    string key_file = argv[3];
+    output_file = argv[4];
+
+    // open the input file and check if it is opened
+    int input_fd = open(input_file.c_str(), O_RDONLY);
+    if (input_fd < 0) {
+#ifdef show_err
+        cerr << file_not_opened << "Input file\n";
+#endif
+        return false;
+    }
+
+    if (!readKeyFile(key_file)) {
+        close(input_fd);
+        return false;
+    }
+
+    // create the output file with its final size, trailing bytes that do not fill a block are dropped in ECB mode
+    struct stat input_stat;
+    if (fstat(input_fd, &input_stat) != 0) {
+#ifdef show_err
+        cerr << "\033[31mError: Input file size could not be read\n\033[0m";
+#endif
+        close(input_fd);
+        return false;
+    }
+    data_size = dataSize(input_stat.st_size);
+    uint64_t size = data_size;
+
+    int output_fd = open(output_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (output_fd < 0 || ftruncate(output_fd, size) != 0) {
+#ifdef show_err
+        cerr << file_not_opened << "Output file\n";
+#endif
+        close(input_fd);
+        if (output_fd >= 0) close(output_fd);
+        return false;
+    }
+
+    DesContext context = createContext();
+
+    const size_t chunk_size_blocks = uring_chunk_size / 8;
+    uint64_t* buffers = new uint64_t[uring_buffers * chunk_size_blocks];
+
+    // a buffer and the transfer it is part of, user_data of its operations is its index
+    struct UringTransfer {
+        uint64_t* blocks;
+        uint64_t offset;  // position of the chunk in both files
+        size_t length;    // bytes of the chunk
+        size_t done;      // bytes already transferred, reads and writes may be short
+        bool writing;
+    };
+    UringTransfer transfers[uring_buffers];
+    struct iovec iovecs[uring_buffers];
+    for (int b = 0; b < uring_buffers; b++) {
+        transfers[b].blocks = buffers + b * chunk_size_blocks;
+        iovecs[b].iov_base = transfers[b].blocks;
+        iovecs[b].iov_len = uring_chunk_size;
+    }
+
+    bool ok = true;
+    {
+        IoUring ring;
+        if (!ring.init(uring_buffers)) {
+#ifdef show_err
+            cerr << "\033[31mError: io_uring could not be set up\n\033[0m";
+#endif
+            ok = false;
+        }
+
+        // registered buffers save pinning the pages of every transfer
+        bool fixed = ok && ring.registerBuffers(iovecs, uring_buffers);
+        uint8_t read_op = fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+        uint8_t write_op = fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        io_path = fixed ? "io_uring (registered buffers)" : "io_uring";
+
+        // queue the rest of the current transfer of a buffer
+        auto submit = [&](int b) {
+            UringTransfer& t = transfers[b];
+            ring.prepare(t.writing ? write_op : read_op, t.writing ? output_fd : input_fd,
+                         reinterpret_cast<char*>(t.blocks) + t.done, static_cast<unsigned>(t.length - t.done),
+                         t.offset + t.done, static_cast<uint16_t>(b), static_cast<uint64_t>(b));
+        };
+
+        uint64_t next_offset = 0;
+        int in_flight = 0;
+        auto startRead = [&](int b) {
+            UringTransfer& t = transfers[b];
+            t.offset = next_offset;
+            t.length = std::min<uint64_t>(uring_chunk_size, size - next_offset);
+            t.done = 0;
+            t.writing = false;
+            next_offset += t.length;
+            in_flight++;
+            submit(b);
+        };
+
+        for (int b = 0; ok && b < uring_buffers && next_offset < size; b++) {
+            startRead(b);
+        }
+
+        while (in_flight > 0) {
+            if (!ring.submitAndWait(1)) {
+                // nothing completes any more, the ring is torn down with the transfers in flight
+                ok = false;
+                break;
+            }
+
+            struct io_uring_cqe cqe;
+            while (ring.popCompletion(cqe)) {
+                int b = static_cast<int>(cqe.user_data);
+                UringTransfer& t = transfers[b];
+
+                // an error, or the end of the input file reached early
+                if (cqe.res <= 0) {
+                    ok = false;
+                    in_flight--;
+                    continue;
+                }
+
+                t.done += cqe.res;
+                if (t.done < t.length) {
+                    submit(b);
+                    continue;
+                }
+
+                if (!t.writing && ok) {
+                    // the chunk is read: process it while the other transfers go on, then write it back
+                    processRangeParallel(t.blocks, t.blocks, t.length, t.offset / 8, context);
+
+                    t.writing = true;
+                    t.done = 0;
+                    submit(b);
+                    continue;
+                }
+
+                // the buffer is free, reuse it for the next chunk
+                in_flight--;
+                if (ok && next_offset < size) {
+                    startRead(b);
+                }
+            }
+        }
+    }
+
+#ifdef show_err
+    if (!ok) {
+        cerr << "\033[31mError: Files could not be processed with io_uring\n\033[0m";
+    }
+#endif
+
+    delete[] buffers;
+    close(input_fd);
+    ok = (close(output_fd) == 0) && ok;
+    return ok;
+#else
+    (void)argv;
+    return false;
+#endif
+}
+
+bool batchFiles(char* argv[]) {
+#ifdef has_mmap
+    string manifest_file = argv[3];
+    string key_file = argv[4];
+
+    // open the manifest file and check if it is opened
+    ifstream manifest_stream(manifest_file);
+    if (!manifest_stream.is_open()) {
+#ifdef show_err
+        cerr << file_not_opened << "Manifest file\n";
+#endif
+        return false;
+    }
+
+    if (!readKeyFile(key_file)) {
+        return false;
+    }
+
+    // input and output paths of every file
+    std::vector<std::pair<string, string>> paths;
+    string line;
+    while (getline(manifest_stream, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+
+        size_t separator = line.find('\t');
+        if (separator == string::npos) separator = line.find(' ');
+        if (separator == string::npos || separator == 0 || separator + 1 == line.size()) {
+#ifdef show_err
+            cerr << "\033[31mError: Manifest line without an input and an output file: " << line << "\n\033[0m";
+#endif
+            return false;
+        }
+        paths.emplace_back(line.substr(0, separator), line.substr(separator + 1));
+    }
+
+    DesContext context = createContext();
+    io_path = "batch";
+
+    std::vector<BatchFile> files(paths.size());
+    for (size_t i = 0; i < files.size(); i++) {
+        files[i].input_file = paths[i].first;
+        files[i].output_file = paths[i].second;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (cipher_mode == MODE_CBC && is_encrypt) {
+        // the chains are serial: the files are split into groups encrypted together, enough groups for every thread
+        size_t num_groups = std::max<size_t>(thread_pool->size(), (files.size() + batch_cbc_group_files - 1) / batch_cbc_group_files);
+        size_t group_files = (files.size() + num_groups - 1) / std::max<size_t>(num_groups, 1);
+        for (size_t first = 0; first < files.size(); first += group_files) {
+            size_t count = std::min(group_files, files.size() - first);
+            thread_pool->submit([&files, first, count, &context] { encryptBatchCbcGroup(&files[first], count, context); });
+        }
+    } else {
+        // all the files are queued at once, their chunks are queued as they are opened
+        for (size_t i = 0; i < files.size(); i++) {
+            thread_pool->submit([&files, i, &context] { startBatchFile(files[i], context); });
+        }
+    }
+    thread_pool->wait();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // per-file and aggregate throughput, the cipher time is summed over the threads
+    size_t num_failed = 0;
+    data_size = 0;
+    for (BatchFile& file : files) {
+        cipher_seconds += file.cipher_nanoseconds / 1e9;
+        if (file.error != nullptr) {
+            num_failed++;
+#ifdef show_err
+            cerr << "\033[31mError: " << file.input_file << ": " << file.error << "\n\033[0m";
+#endif
+            continue;
+        }
+
+        double file_seconds = std::chrono::duration<double>(file.end - file.start).count();
+        data_size += file.size;
+        cout << file.input_file << " -> " << file.output_file << ": " << file.size << " bytes in " << file_seconds << " s, "
+             << (file_seconds > 0 ? file.size / file_seconds / 1e6 : 0) << " MB/s\n";
+    }
+    cout << "batch: " << files.size() - num_failed << " files, " << num_failed << " failed, " << data_size << " bytes in "
+         << seconds << " s, " << (seconds > 0 ? data_size / seconds / 1e6 : 0) << " MB/s\n";
+    return num_failed == 0;
+#else
+    (void)argv;
+    return false;
+#endif
+}
+
+#ifdef has_mmap
+bool openBatchFile(BatchFile& file, int& input_fd, int& output_fd) {
+    file.start = std::chrono::steady_clock::now();
+    file.end = file.start;
+
+    input_fd = open(file.input_file.c_str(), O_RDONLY);
+    if (input_fd < 0) {
+        failBatchFile(file, "input file not opened");
+        return false;
+    }
+
+    // trailing bytes that do not fill a block are dropped in ECB mode
+    struct stat input_stat;
+    if (fstat(input_fd, &input_stat) != 0) {
+        failBatchFile(file, "input file size could not be read");
+        close(input_fd);
+        return false;
+    }
+    file.file_size = input_stat.st_size;
+    file.size = dataSize(file.file_size);
+    if (cipher_mode == MODE_CBC && !is_encrypt && (file.size != file.file_size || file.size == 0)) {
+        failBatchFile(file, "CBC ciphertext must be a non-empty multiple of eight bytes");
+        close(input_fd);
+        return false;
+    }
+
+    output_fd = open(file.output_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (output_fd < 0 || ftruncate(output_fd, file.size) != 0) {
+        failBatchFile(file, "output file not opened");
+        close(input_fd);
+        if (output_fd >= 0) close(output_fd);
+        return false;
+    }
     return true;
 }
 
-inline uint64_t swapEndianness(uint64_t value) {
-    if (!isLittleEndian()) return value;
+void startBatchFile(BatchFile& file, const DesContext& context) {
+    int input_fd, output_fd;
+    if (!openBatchFile(file, input_fd, output_fd)) return;
+
+    size_t num_chunks = (file.size + batch_chunk_size - 1) / batch_chunk_size;
+    file.remaining = num_chunks;
+
+    if (num_chunks > 0) {
+        // the other chunks are independent, they reopen the files so that no descriptor is held while queued
+        for (size_t c = 1; c < num_chunks; c++) {
+            thread_pool->submit([&file, c, &context] {
+                int chunk_input_fd = open(file.input_file.c_str(), O_RDONLY);
+                int chunk_output_fd = open(file.output_file.c_str(), O_WRONLY);
+                if (chunk_input_fd < 0 || chunk_output_fd < 0) {
+                    failBatchFile(file, "file not opened");
+                }
+                runBatchChunk(file, chunk_input_fd, chunk_output_fd, c * batch_chunk_size, context);
+                if (chunk_input_fd >= 0) close(chunk_input_fd);
+                if (chunk_output_fd >= 0 && close(chunk_output_fd) != 0) {
+                    failBatchFile(file, "output file could not be written");
+                }
+            });
+        }
+        runBatchChunk(file, input_fd, output_fd, 0, context);
+    }
 
-    return ((value & 0x00000000000000FFULL) << 56) |
-           ((value & 0x000000000000FF00ULL) << 40) |
-           ((value & 0x0000000000FF0000ULL) << 24) |
-           ((value & 0x00000000FF000000ULL) << 8) |
-           ((value & 0x000000FF00000000ULL) >> 8) |
-           ((value & 0x0000FF0000000000ULL) >> 24) |
-           ((value & 0x00FF000000000000ULL) >> 40) |
-           ((value & 0xFF00000000000000ULL) >> 56);
+    close(input_fd);
+    if (close(output_fd) != 0) {
+        failBatchFile(file, "output file could not be written");
+    }
 }
 
-void swapEndiannessForArray(uint64_t* arr) {
-    if (!isLittleEndian()) return;
+void encryptBatchCbcGroup(BatchFile* files, size_t count, const DesContext& context) {
+    std::vector<int> input_fds(count, -1), output_fds(count, -1);
+    for (size_t i = 0; i < count; i++) {
+        if (!openBatchFile(files[i], input_fds[i], output_fds[i])) {
+            input_fds[i] = output_fds[i] = -1;
+        }
+        files[i].chain = iv;
+    }
 
-    for (size_t i = 0; i < num_blocks; i++) {
-        arr[i] = swapEndianness(arr[i]);
+    // one slot of batch_cbc_chunk_size bytes per file
+    std::unique_ptr<uint64_t[]> buffer(new uint64_t[count * (batch_cbc_chunk_size / 8)]);
+    std::vector<DesCbcStream> streams;
+    std::vector<size_t> stream_files;
+
+    for (uint64_t offset = 0;; offset += batch_cbc_chunk_size) {
+        streams.clear();
+        stream_files.clear();
+        for (size_t i = 0; i < count; i++) {
+            BatchFile& file = files[i];
+            if (input_fds[i] < 0 || file.error != nullptr || offset >= file.size) continue;
+
+            // the PKCS#7 padding is not in the input file
+            uint8_t* bytes = reinterpret_cast<uint8_t*>(buffer.get() + i * (batch_cbc_chunk_size / 8));
+            size_t length = std::min<uint64_t>(batch_cbc_chunk_size, file.size - offset);
+            size_t read_length = std::min<uint64_t>(length, file.file_size - std::min(offset, file.file_size));
+            if (!preadFully(input_fds[i], bytes, read_length, offset)) {
+                failBatchFile(file, "input file could not be read");
+                continue;
+            }
+            memset(bytes + read_length, static_cast<int>(file.size - file.file_size), length - read_length);
+
+            streams.push_back(DesCbcStream{bytes, length, file.chain});
+            stream_files.push_back(i);
+        }
+        if (streams.empty()) break;
+
+        // the kernel time is shared between the files by their bytes
+        auto start = std::chrono::steady_clock::now();
+        context.cbc_encrypt_streams(streams.data(), streams.size());
+        uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        size_t step_size = 0;
+        for (const DesCbcStream& stream : streams) step_size += stream.size;
+
+        for (size_t s = 0; s < streams.size(); s++) {
+            BatchFile& file = files[stream_files[s]];
+            file.chain = streams[s].chain;
+            file.cipher_nanoseconds += nanoseconds * streams[s].size / step_size;
+            if (!pwriteFully(output_fds[stream_files[s]], streams[s].data, streams[s].size, offset)) {
+                failBatchFile(file, "output file could not be written");
+            }
+            if (offset + streams[s].size == file.size) {
+                file.end = std::chrono::steady_clock::now();
+            }
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (input_fds[i] < 0) continue;
+        close(input_fds[i]);
+        if (close(output_fds[i]) != 0) {
+            failBatchFile(files[i], "output file could not be written");
+        }
     }
 }
 
-bool isLittleEndian() {
-    uint16_t num = 1;
-    return *(reinterpret_cast<char*>(&num)) == 1;
+void runBatchChunk(BatchFile& file, int input_fd, int output_fd, uint64_t offset, const DesContext& context) {
+    // one buffer per thread, reused by all the chunks it runs
+    thread_local std::unique_ptr<uint64_t[]> buffer(new uint64_t[batch_chunk_size / 8]);
+    uint64_t* blocks = buffer.get();
+
+    size_t length = std::min<uint64_t>(batch_chunk_size, file.size - offset);
+    if (file.error == nullptr && !preadFully(input_fd, blocks, length, offset)) {
+        failBatchFile(file, "input file could not be read");
+    }
+
+    if (file.error == nullptr) {
+        auto start = std::chrono::steady_clock::now();
+        size_t write_length = length;
+
+        if (cipher_mode != MODE_CBC) {
+            processRange(blocks, blocks, length, offset / 8, context);
+        } else {
+            // the ciphertext block preceding the chunk, the IV for the first one
+            uint64_t chain = iv;
+            uint8_t previous[8] = {};
+            if (offset > 0) {
+                if (!preadFully(input_fd, previous, 8, offset - 8)) {
+                    failBatchFile(file, "input file could not be read");
+                }
+                chain = blockValue(previous);
+            }
+            uint8_t* bytes = reinterpret_cast<uint8_t*>(blocks);
+            context.cbc_decrypt_bytes(bytes, bytes, length, chain);
+
+            // the last chunk checks and removes the padding
+            if (offset + length == file.size) {
+                unsigned padding = paddingLength(reinterpret_cast<const unsigned char*>(blocks) + length);
+                if (padding == 0) {
+                    failBatchFile(file, "invalid CBC padding, wrong key or IV");
+                }
+                write_length -= padding;
+            }
+        }
+        file.cipher_nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+        if (file.error == nullptr &&
+            (!pwriteFully(output_fd, blocks, write_length, offset) ||
+             (write_length < length && ftruncate(output_fd, offset + write_length) != 0))) {
+            failBatchFile(file, "output file could not be written");
+        }
+    }
+
+    if (file.remaining.fetch_sub(1) == 1) {
+        file.end = std::chrono::steady_clock::now();
+    }
 }
 
-void processData() {
-    // keys generation
-    uint64_t keys[16];  // place holder variable for 16 subkeys
-    keyGeneration(keys); // each key is a 48 bit ater permutation choice 2
+void failBatchFile(BatchFile& file, const char* error) {
+    const char* none = nullptr;
+    file.error.compare_exchange_strong(none, error);
+}
+
+bool preadFully(int fd, void* buffer, size_t size, uint64_t offset) {
+    char* bytes = static_cast<char*>(buffer);
+    while (size > 0) {
+        ssize_t n = pread(fd, bytes, size, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        bytes += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
 
-    // apply DES algorithm into each block
-    for (size_t i = 0; i < num_blocks; i++) {
-        data_blocks[i] = DES(data_blocks[i], keys);
+bool pwriteFully(int fd, const void* buffer, size_t size, uint64_t offset) {
+    const char* bytes = static_cast<const char*>(buffer);
+    while (size > 0) {
+        ssize_t n = pwrite(fd, bytes, size, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        bytes += n;
+        size -= n;
+        offset += n;
     }
+    return true;
 }
+#endif
+
+bool searchKeys(char* argv[]) {
+    string pairs_file = argv[2];
+    string key_space = argv[3];
+    string checkpoint_file = argv[4];
+
+    // open the pairs file and check if it is opened
+    ifstream pairs_stream(pairs_file);
+    if (!pairs_stream.is_open()) {
+#ifdef show_err
+        cerr << file_not_opened << "Pairs file\n";
+#endif
+        return false;
+    }
 
+    // plaintext and ciphertext of each pair, the first pair drives the kernel and the others verify its candidates
+    std::vector<uint64_t> pairs;
+    string line;
+    while (getline(pairs_stream, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+
+        std::istringstream fields(line);
+        string plaintext, ciphertext, extra;
+        uint64_t p, c;
+        if (!(fields >> plaintext >> ciphertext) || (fields >> extra) || !parseHex64(plaintext, p) || !parseHex64(ciphertext, c)) {
+#ifdef show_err
+            cerr << "\033[31mError: Invalid pair: " << line << "\n\033[0m";
+#endif
+            return false;
+        }
+        pairs.push_back(p);
+        pairs.push_back(c);
+    }
 
+    uint64_t known_key, known_mask;
+    size_t slash = key_space.find('/');
+    if (pairs.empty() || slash == string::npos || !parseHex64(key_space.substr(0, slash), known_key) ||
+        !parseHex64(key_space.substr(slash + 1), known_mask)) {
+#ifdef show_err
+        cerr << "\033[31mError: search needs at least one pair and a key space <16 hex digits>/<16 hex digits>\n\033[0m";
+#endif
+        return false;
+    }
 
+    SearchSpace space;
+    buildSearchSpace(space, known_key & known_mask, known_mask);
+    SearchBlock block;
+    buildSearchBlock(block, pairs[0], pairs[1]);
+    const SearchKernel* kernel = selectSearchKernel(bitslice_kernel);
+    const size_t num_pairs = pairs.size() / 2;
+    const uint64_t num_units = (space.size() + search_unit_keys - 1) / search_unit_keys;
+
+    // resume from the checkpoint
+    string search_id = "des-search " + toHex64(space.key) + "/" + toHex64(space.mask) + " " + toHex64(pairs[0]) + " " + toHex64(pairs[1]);
+    uint64_t first_unit = 0;
+    bool found = false;
+    uint64_t found_key = 0;
+    if (!readSearchCheckpoint(checkpoint_file, search_id, first_unit, found, found_key)) {
+        return false;
+    }
 
-void keyGeneration(uint64_t* keys) {
-    // Apply Permuted Choice 1 to the original key
-    uint64_t permuted_key = permute(key, pc_1, 56, 64);
+    if (found) {
+        cout << "key: " << toHex64(withOddParity(found_key)) << " (from the checkpoint)\n";
+        return true;
+    }
 
-    // Split the permuted key into two 28-bit halves
-    uint32_t C = (permuted_key >> 28) & 0x0FFFFFFF; // Left half
-    uint32_t D = permuted_key & 0x0FFFFFFF;         // Right half
+    std::atomic<uint64_t> next_unit{std::min(first_unit, num_units)};
+    std::atomic<bool> key_found{false};
+    std::atomic<uint64_t> result{0};
+    std::atomic<uint64_t> keys_searched{0};
 
-    // Generate 16 subkeys
-    for (int i = 0; i < 16; i++) {
-        // Perform left shifts according to the shift table
-        C = leftShiftRotate(C, i);
-        D = leftShiftRotate(D, i);
+    // unit claimed by each thread, every unit below all of them and below next_unit is done
+    const unsigned num_workers = thread_pool->size();
+    std::unique_ptr<std::atomic<uint64_t>[]> claimed(new std::atomic<uint64_t>[num_workers]);
+    for (unsigned t = 0; t < num_workers; t++) {
+        claimed[t] = UINT64_MAX;
+    }
+    auto unitsDone = [&] {
+        uint64_t done = next_unit.load();
+        for (unsigned t = 0; t < num_workers; t++) {
+            done = std::min<uint64_t>(done, claimed[t].load());
+        }
+        return std::min(done, num_units);
+    };
+
+    std::mutex checkpoint_mutex;
+    auto start = std::chrono::steady_clock::now();
+    auto last_checkpoint = start;
+    bool ok = true;
+
+    for (unsigned t = 0; t < num_workers; t++) {
+        thread_pool->submit([&, t] {
+            uint64_t candidates[8];
+            SearchKeyPlanes planes;
+            while (!key_found) {
+                // claim a lower bound first, so that the unit taken is never counted as done
+                claimed[t] = next_unit.load();
+                uint64_t unit = next_unit.fetch_add(1);
+                if (unit >= num_units) break;
+                claimed[t] = unit;
+
+                // the batches of the unit in Gray-code order, the sizes are powers of two
+                uint64_t first = unit * search_unit_keys;
+                uint64_t end = std::min(first + search_unit_keys, space.size());
+                uint64_t num_batches = std::max<uint64_t>(1, (end - first) / kernel->keys);
+                planes.start(space, static_cast<int>(kernel->keys / 64), first);
+                for (uint64_t n = 0; n < num_batches; n++) {
+                    if (n > 0) planes.next(space);
+                    kernel->run(planes, block, candidates);
+
+                    for (size_t w = 0; w < kernel->keys / 64; w++) {
+                        for (uint64_t bits = candidates[w]; bits != 0; bits &= bits - 1) {
+                            uint64_t index = planes.batch + 64 * w + __builtin_ctzll(bits);
+                            if (index < end && verifySearchKey(searchKeyAt(space, index), pairs.data(), num_pairs)) {
+                                result = searchKeyAt(space, index);
+                                key_found = true;
+                            }
+                        }
+                    }
+                }
+                keys_searched += end - first;
+
+                // save the progress from time to time, by the first thread to get there
+                if (checkpoint_mutex.try_lock()) {
+                    auto now = std::chrono::steady_clock::now();
+                    if (std::chrono::duration<double>(now - last_checkpoint).count() >= search_checkpoint_seconds) {
+                        last_checkpoint = now;
+                        uint64_t done = unitsDone();
+                        double seconds = std::chrono::duration<double>(now - start).count();
+                        if (!writeSearchCheckpoint(checkpoint_file, search_id, done, false, 0)) {
+                            ok = false;
+                        }
+#ifdef show_err
+                        cerr << "checkpoint: " << done << " / " << num_units << " tasks, " << keys_searched / seconds << " keys/s\n";
+#endif
+                    }
+                    checkpoint_mutex.unlock();
+                }
+            }
+            claimed[t] = UINT64_MAX;
+        });
+    }
+    thread_pool->wait();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    found = key_found;
+    if (!writeSearchCheckpoint(checkpoint_file, search_id, unitsDone(), found, result) || !ok) {
+#ifdef show_err
+        cerr << "\033[31mError: Checkpoint file could not be written\n\033[0m";
+#endif
+    }
+
+    if (found) {
+        cout << "key: " << toHex64(withOddParity(result)) << "\n";
+    } else {
+        cout << "no key found\n";
+    }
+    uint64_t keys = keys_searched;
+    double keys_per_second = seconds > 0 ? keys / seconds : 0;
+    cout << "searched " << keys << " keys in " << seconds << " s, " << keys_per_second << " keys/s, "
+         << keys_per_second / num_workers << " keys/s per core (" << num_workers << " threads, " << kernel->name << ")\n";
+    return found;
+}
 
-        // Combine C and D into a 56-bit key
-        uint64_t combined_halves = ((uint64_t)C << 28) | D;
+bool readSearchCheckpoint(const string& checkpoint_file, const string& search_id, uint64_t& next_unit, bool& found, uint64_t& key) {
+    ifstream checkpoint_stream(checkpoint_file);
+    if (!checkpoint_stream.is_open()) {
+        return true;
+    }
+
+    // the search line, then "next <unit>" and "found <key>" once the key is found
+    string line;
+    bool valid = getline(checkpoint_stream, line) && line == search_id;
+    while (valid && getline(checkpoint_stream, line)) {
+        std::istringstream fields(line);
+        string name, value;
+        fields >> name >> value;
+        if (name == "next" && !value.empty() && value.find_first_not_of("0123456789") == string::npos) {
+            next_unit = stoull(value);
+        } else if (name == "found") {
+            valid = parseHex64(value, key);
+            found = true;
+        } else if (!name.empty()) {
+            valid = false;
+        }
+    }
 
-        // Apply Permuted Choice 2 to get the 48-bit subkey
-        keys[i] = permute(combined_halves, pc_2, 48, 56);
+    if (!valid) {
+#ifdef show_err
+        cerr << "\033[31mError: Checkpoint file " << checkpoint_file << " is invalid or belongs to another search\n\033[0m";
+#endif
+        return false;
     }
+    return true;
+}
 
-    // Reverse the order of the keys for decryption
-    if (!is_encrypt) {
-        for (int i = 0; i < 8; i++) {
-            std::swap(keys[i], keys[15 - i]);
+bool writeSearchCheckpoint(const string& checkpoint_file, const string& search_id, uint64_t next_unit, bool found, uint64_t key) {
+    // a crash leaves either the previous checkpoint or the new one
+    string temporary_file = checkpoint_file + ".tmp";
+    {
+        ofstream checkpoint_stream(temporary_file, ios::trunc);
+        checkpoint_stream << search_id << "\nnext " << next_unit << "\n";
+        if (found) {
+            checkpoint_stream << "found " << toHex64(key) << "\n";
         }
+        checkpoint_stream.close();
+        if (!checkpoint_stream) return false;
     }
+    return rename(temporary_file.c_str(), checkpoint_file.c_str()) == 0;
 }
 
-inline uint32_t leftShiftRotate(uint32_t value, int round) {
-    int shifts = left_shift_table[round];
-    return ((value << shifts) | (value >> (28 - shifts))) & 0x0FFFFFFF;
+bool parseHex64(const string& text, uint64_t& value) {
+    if (text.size() != 16 || text.find_first_not_of("0123456789abcdefABCDEF") != string::npos) return false;
+    value = stoull(text, nullptr, 16);
+    return true;
+}
+
+string toHex64(uint64_t value) {
+    char text[17];
+    snprintf(text, sizeof(text), "%016llX", static_cast<unsigned long long>(value));
+    return text;
+}
+
+uint64_t withOddParity(uint64_t key) {
+    for (int byte = 0; byte < 8; byte++) {
+        uint64_t bits = (key >> (8 * byte + 1)) & 0x7F;
+        uint64_t parity = (__builtin_popcountll(bits) & 0x01) ^ 0x01;
+        key = (key & ~(uint64_t(1) << (8 * byte))) | (parity << (8 * byte));
+    }
+    return key;
+}
+
+void reportStats(double seconds) {
+    uint64_t bytes = data_size;
+    cerr << (is_encrypt ? "encrypt " : "decrypt ") << (is_triple_des ? "3DES " : "DES ") << cipher_mode_names[cipher_mode] << ", I/O path: " << io_path << ", " << bytes << " bytes in " << seconds << " s, "
+         << (seconds > 0 ? bytes / seconds / 1e6 : 0) << " MB/s (cipher " << cipher_seconds << " s)\n";
+}
+
+uint64_t dataSize(uint64_t file_size) {
+    if (cipher_mode == MODE_CTR) return file_size;
+
+    // PKCS#7 adds 1 to 8 bytes to fill the last block
+    if (cipher_mode == MODE_CBC && is_encrypt) return file_size - file_size % 8 + 8;
+    return file_size - file_size % 8;
+}
+
+unsigned paddingLength(const unsigned char* end) {
+    // PKCS#7: n bytes of value n
+    unsigned padding = end[-1];
+    if (padding < 1 || padding > 8) return 0;
+    for (unsigned i = 2; i <= padding; i++) {
+        if (end[-static_cast<int>(i)] != padding) return 0;
+    }
+    return padding;
+}
+
+bool writeOutputFile() {
+    // check if output file exists
+    ofstream output_file_stream = ofstream(output_file, ios::binary | ios::trunc);
+    if (!output_file_stream.is_open()) {
+#ifdef show_err
+        cerr << file_not_opened << "Output file\n";
+#endif
+        return false;
+    }
+
+    // write the data to the output file
+    output_file_stream.write(reinterpret_cast<char*>(data_blocks), data_size);
+    output_file_stream.close();
+
+    delete[] data_blocks;
+
+    return true;
 }
 
-uint64_t DES(const uint64_t& block, const uint64_t* keys) {
-    // initial permutation
-    // block_new = ??
-    // TODO: implement initial permutation
-   uint64_t block_new = permute(block, IP_t, 64, 64);
 
-    uint32_t l = static_cast<uint32_t>(block_new >> 32);
-    uint32_t r = static_cast<uint32_t>(block_new & 0xFFFFFFFF);
+bool processData() {
+    // keys generation, prepared once for all the threads
+    DesContext context = createContext();
 
-    // perform 16 rounds
-    for (int i = 0; i < 16; i++) {
-        uint32_t temp = r;
-        r = l ^ DES_round(r, keys[i]);
-        l = temp;
+    if (cipher_mode != MODE_CBC) {
+        processRangeParallel(data_blocks, data_blocks, data_size, 0, context);
+        return true;
     }
 
-    // comnine the two halves and swap them
-    block_new = ((uint64_t)r << 32) | l;
+    if (is_encrypt) {
+        // a single chain: every block depends on the previous one, so the file is encrypted serially
+        auto start = std::chrono::steady_clock::now();
+        uint8_t* bytes = reinterpret_cast<uint8_t*>(data_blocks);
+        uint64_t chain = iv;
+        context.cbc_encrypt_bytes(bytes, bytes, num_blocks * 8, chain);
+        cipher_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return true;
+    }
 
-    // final permutation
-    // TODO: implement final permutation
-    uint64_t fp_output = permute(block_new, P_1, 64, 64);
+    cbcDecryptParallel(data_blocks, num_blocks, context);
 
+    // check and remove the PKCS#7 padding
+    unsigned padding = paddingLength(reinterpret_cast<const unsigned char*>(data_blocks) + data_size);
+    if (padding == 0) {
+#ifdef show_err
+        cerr << "\033[31mError: Invalid CBC padding, wrong key or IV\n\033[0m";
+#endif
+        return false;
+    }
+    data_size -= padding;
+    return true;
+}
+
+
+void cbcDecryptParallel(uint64_t* blocks, size_t count, const DesContext& context) {
+    // the tasks start at multiples of chunk_blocks, save the ciphertext block before each of them
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(blocks);
+    std::vector<uint64_t> chains((count + chunk_blocks - 1) / chunk_blocks);
+    for (size_t t = 0; t < chains.size(); t++) {
+        chains[t] = (t == 0) ? iv : blockValue(bytes + t * chunk_blocks * 8 - 8);
+    }
 
-    return fp_output;
+    runChunks(count, [bytes, &chains, &context](size_t first, size_t task_count) {
+        uint64_t chain = chains[first / chunk_blocks];
+        context.cbc_decrypt_bytes(bytes + first * 8, bytes + first * 8, task_count * 8, chain);
+    });
+}
+
+uint64_t blockValue(const uint8_t* bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
 }
 
-uint64_t DES_round(uint64_t r, const uint64_t& key) {
-    // right half operations
+DesContext createContext() {
+    // keys generation, both orders at once
+    DesKey des_key = is_triple_des ? DesKey(ede_keys[0], ede_keys[1], ede_keys[2]) : DesKey(key);
+    return DesContext(des_key, bitslice_kernel->name);
+}
 
-    // expansion permutation
-    // TODO: implement expansion permutation
-    // r = ??
-   uint64_t expanded_r = permute(static_cast<uint64_t>(r) << 32, E_t, 48, 32);
+void processRange(const uint64_t* input, uint64_t* output, size_t size, uint64_t first_block, const DesContext& context) {
+    const uint8_t* input_bytes = reinterpret_cast<const uint8_t*>(input);
+    uint8_t* output_bytes = reinterpret_cast<uint8_t*>(output);
+    if (cipher_mode == MODE_CTR) {
+        context.ctr_bytes(input_bytes, output_bytes, size, iv + first_block);
+    } else if (is_encrypt) {
+        context.encrypt_bytes(input_bytes, output_bytes, size);
+    } else {
+        context.decrypt_bytes(input_bytes, output_bytes, size);
+    }
+}
 
+void processRangeParallel(const uint64_t* input, uint64_t* output, size_t size, uint64_t first_block, const DesContext& context) {
+    runChunks((size + 7) / 8, [=, &context](size_t first, size_t task_count) {
+        size_t task_size = std::min<size_t>(task_count * 8, size - first * 8);
+        processRange(input + first, output + first, task_size, first_block + first, context);
+    });
+}
 
-    // XOR with key, both 48 bits
-    uint64_t xor_r = (expanded_r ^ key);
 
-    // S-boxes, result is 32 bits
-    uint64_t sBox_output = SBox(xor_r);
+template <typename F>
+void runChunks(size_t count, F process) {
+    auto start = std::chrono::steady_clock::now();
 
-    // permutation
-    // TODO: implement permutation
-    // r = ??
-    uint32_t permuted_output = static_cast<uint32_t>(permute(sBox_output, P, 32, 32));
+    if (thread_pool->size() == 1 || count <= chunk_blocks) {
+        process(0, count);
+    } else {
+        // split the blocks into cache-sized tasks
+        for (size_t i = 0; i < count; i += chunk_blocks) {
+            size_t task_count = std::min(chunk_blocks, count - i);
+            thread_pool->submit([&process, i, task_count] { process(i, task_count); });
+        }
+        thread_pool->wait();
+    }
 
-    // combine the two halves
-    return permuted_output;
-}
\ No newline at end of file
+    cipher_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
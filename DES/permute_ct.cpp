@@ -0,0 +1,281 @@
+#include <stdint.h>
+
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+// Compile-time permutation compiler.
+//
+// permute<Table, TotalBits>(x) turns a constexpr DES table into straight-line code while compiling.
+// Three programs are built for every table and compared with the byte-indexed tables of permute_lut.cpp:
+//  - masked rotations: one (x & mask) rotated into place for each distinct bit displacement,
+//  - delta swaps: a Benes network of at most 11 delta swaps, for tables without repeated bits,
+//  - pext/pdep pairs: one per chain of bits keeping their relative order (only with BMI2).
+// The cheapest form is emitted: the byte tables for IP, FP, PC-1, PC-2 and P, whose delta swaps form a
+// serial chain of about 60 operations and whose pext/pdep pairs wait on one port, and the rotations for E.
+
+/**
+ * @brief Straight-line programs computing one permutation table.
+ *
+ * Bit positions are counted from the least significant bit.
+ */
+struct PermutationProgram {
+    // masked rotations: output |= rotl(input & rot_mask[g], rot_shift[g])
+    int rot_count = 0;
+    uint64_t rot_mask[64] = {};
+    int rot_shift[64] = {};
+
+    // delta swaps: t = ((x >> delta) ^ x) & mask; x ^= t ^ (t << delta), then output = x & out_mask
+    bool injective = true;
+    int swap_count = 0;
+    uint64_t swap_mask[11] = {};
+    int swap_delta[11] = {};
+    uint64_t out_mask = 0;
+
+    // chains: output |= pdep(pext(input, chain_src[c]), chain_dst[c])
+    int chain_count = 0;
+    uint64_t chain_src[64] = {};
+    uint64_t chain_dst[64] = {};
+};
+
+enum PermutationMethod { PERMUTE_ROTATIONS, PERMUTE_DELTA_SWAPS, PERMUTE_CHAINS, PERMUTE_BYTE_TABLES };
+
+/**
+ * @brief Route a permutation of 64 bits through a Benes network of delta swaps.
+ *
+ * @param prog The program receiving the swap stages.
+ * @param dst_in dst_in[s] is the output position of input bit s, a permutation of 0..63.
+ *
+ * Stages use deltas 32, 16, ..., 1 then 2, ..., 32. Each 2^k block is split between its two halves
+ * with the looping algorithm; stages whose mask is zero are dropped.
+ */
+static constexpr void routeBenes(PermutationProgram& prog, const int* dst_in) {
+    int dst[64] = {};
+    for (int i = 0; i < 64; i++) dst[i] = dst_in[i];
+
+    uint64_t in_masks[6] = {};
+    uint64_t out_masks[6] = {};
+
+    for (int level = 0; level < 6; level++) {
+        int size = 64 >> level;
+        int h = size / 2;
+        int next[64] = {};
+
+        for (int base = 0; base < 64; base += size) {
+            // last level: a single switch
+            if (size == 2) {
+                if (dst[base] != base) in_masks[level] |= 1ULL << base;
+                continue;
+            }
+
+            int src[64] = {};
+            for (int i = 0; i < size; i++) src[dst[base + i] - base] = i;
+
+            // side[i]: half of the block input i is routed through
+            int side[64] = {};
+            for (int i = 0; i < size; i++) side[i] = -1;
+            for (int start = 0; start < size; start++) {
+                if (side[start] != -1) continue;
+                int i = start;
+                side[i] = 0;
+                while (true) {
+                    // the input partner takes the other half, and the source of its output partner
+                    // must take the half of i
+                    int k = i ^ h;
+                    side[k] = 1 - side[i];
+                    int m = src[(dst[base + k] - base) ^ h];
+                    if (side[m] != -1) break;
+                    side[m] = side[i];
+                    i = m;
+                }
+            }
+
+            for (int i = 0; i < h; i++) {
+                if (side[i] == 1) in_masks[level] |= 1ULL << (base + i);
+                if (side[src[i]] == 1) out_masks[level] |= 1ULL << (base + i);
+            }
+            for (int i = 0; i < size; i++) {
+                int half = base + side[i] * h;
+                next[half + (i % h)] = half + ((dst[base + i] - base) % h);
+            }
+        }
+
+        if (size > 2) {
+            for (int i = 0; i < 64; i++) dst[i] = next[i];
+        }
+    }
+
+    for (int level = 0; level < 6; level++) {
+        if (in_masks[level] == 0) continue;
+        prog.swap_mask[prog.swap_count] = in_masks[level];
+        prog.swap_delta[prog.swap_count++] = 32 >> level;
+    }
+    for (int level = 4; level >= 0; level--) {
+        if (out_masks[level] == 0) continue;
+        prog.swap_mask[prog.swap_count] = out_masks[level];
+        prog.swap_delta[prog.swap_count++] = 32 >> level;
+    }
+}
+
+/**
+ * @brief Compile a permutation table into its straight-line programs.
+ *
+ * @param table The permutation table defining the new bit order (1-based, MSB first).
+ * @param table_size The number of bits to permute.
+ * @param total_bits The total number of bits in the input.
+ * @return The programs, all equivalent to permute(input, table, table_size, total_bits).
+ */
+static constexpr PermutationProgram compilePermutation(const int* table, int table_size, int total_bits) {
+    PermutationProgram prog;
+
+    // source position of every output bit
+    int src_of[64] = {};
+    for (int i = 0; i < table_size; i++) src_of[table_size - 1 - i] = total_bits - table[i];
+
+    // masked rotations, grouped by displacement
+    for (int o = 0; o < table_size; o++) {
+        int shift = (o - src_of[o] + 64) % 64;
+        int g = 0;
+        while (g < prog.rot_count && prog.rot_shift[g] != shift) g++;
+        if (g == prog.rot_count) prog.rot_shift[prog.rot_count++] = shift;
+        prog.rot_mask[g] |= 1ULL << src_of[o];
+    }
+
+    // delta swaps, when every input bit is used at most once
+    int dst[64] = {};
+    bool used_src[64] = {};
+    bool used_dst[64] = {};
+    for (int i = 0; i < 64; i++) dst[i] = -1;
+    for (int o = 0; o < table_size; o++) {
+        if (dst[src_of[o]] != -1) prog.injective = false;
+        dst[src_of[o]] = o;
+        used_src[src_of[o]] = true;
+        used_dst[o] = true;
+    }
+    if (prog.injective) {
+        // unused input bits fill the unused output positions, above table_size, and are masked off
+        int free_dst = 0;
+        for (int s = 0; s < 64; s++) {
+            if (used_src[s]) continue;
+            while (used_dst[free_dst]) free_dst++;
+            dst[s] = free_dst++;
+        }
+        routeBenes(prog, dst);
+        prog.out_mask = (table_size == 64) ? ~0ULL : ((1ULL << table_size) - 1);
+    }
+
+    // chains of increasing source positions, best fit
+    int chain_last[64] = {};
+    for (int o = 0; o < table_size; o++) {
+        int s = src_of[o];
+        int best = -1;
+        for (int c = 0; c < prog.chain_count; c++) {
+            if (chain_last[c] < s && (best == -1 || chain_last[c] > chain_last[best])) best = c;
+        }
+        if (best == -1) best = prog.chain_count++;
+        chain_last[best] = s;
+        prog.chain_src[best] |= 1ULL << s;
+        prog.chain_dst[best] |= 1ULL << o;
+    }
+
+    return prog;
+}
+
+/**
+ * @brief Pick the cheapest form of a permutation.
+ *
+ * @param prog The programs of the table.
+ * @param total_bits The total number of bits in the input, the byte tables take one lookup per byte.
+ *
+ * The costs estimate the latency of one permutation in fifths of a cycle, calibrated on the permute
+ * benchmarks of bench_des. The rotations are independent and bound by issue, each delta swap waits for
+ * the previous one, a lookup adds the load latency, and pext and pdep take three cycles on a single port.
+ */
+static constexpr PermutationMethod selectPermutationMethod(const PermutationProgram& prog, int total_bits) {
+    int rotations = 8 * prog.rot_count;
+    int swaps = prog.injective ? 35 * prog.swap_count : 1 << 30;
+    int byte_tables = 22 * (total_bits / 8);
+    int chains = 30 * prog.chain_count;
+#if !defined(__BMI2__)
+    chains = 1 << 30;
+#endif
+    int best = std::min({rotations, swaps, byte_tables, chains});
+    if (chains == best) return PERMUTE_CHAINS;
+    if (byte_tables == best) return PERMUTE_BYTE_TABLES;
+    return (swaps == best) ? PERMUTE_DELTA_SWAPS : PERMUTE_ROTATIONS;
+}
+
+/**
+ * @brief Byte-indexed tables of a permutation table, built by initPermutationTables().
+ *
+ * Specialized next to the tables for every table passed to permute<Table>(), which reads them when
+ * selectPermutationMethod() picks them.
+ */
+template <const auto& Table>
+static inline const PermutationLUT& permutationLUT();
+
+/**
+ * @brief Compiled form of a permutation table.
+ */
+template <const auto& Table, int TotalBits>
+struct StaticPermutation {
+    static constexpr int table_size = std::extent<std::remove_reference_t<decltype(Table)>>::value;
+    static constexpr PermutationProgram program = compilePermutation(Table, table_size, TotalBits);
+    static constexpr PermutationMethod method = selectPermutationMethod(program, TotalBits);
+};
+
+static inline uint64_t rotl64(uint64_t x, int shift) {
+    return (x << shift) | (x >> ((64 - shift) & 63));
+}
+
+template <const PermutationProgram& Prog, size_t... G>
+static inline uint64_t permuteRotations(uint64_t input, std::index_sequence<G...>) {
+    return (rotl64(input & Prog.rot_mask[G], Prog.rot_shift[G]) | ...);
+}
+
+template <const PermutationProgram& Prog, size_t... S>
+static inline uint64_t permuteDeltaSwaps(uint64_t x, std::index_sequence<S...>) {
+    uint64_t t = 0;
+    ((t = ((x >> Prog.swap_delta[S]) ^ x) & Prog.swap_mask[S], x ^= t ^ (t << Prog.swap_delta[S])), ...);
+    return x & Prog.out_mask;
+}
+
+template <size_t... B>
+static inline uint64_t permuteBytes(uint64_t input, const PermutationLUT& perm, std::index_sequence<B...>) {
+    return (perm.lut[B][(input >> (8 * B)) & 0xFF] | ...);
+}
+
+#if defined(__BMI2__)
+template <const PermutationProgram& Prog, size_t... C>
+static inline uint64_t permuteChains(uint64_t input, std::index_sequence<C...>) {
+    return (_pdep_u64(_pext_u64(input, Prog.chain_src[C]), Prog.chain_dst[C]) | ...);
+}
+#endif
+
+/**
+ * @brief Permutation compiled from a constexpr table.
+ *
+ * @tparam Table The permutation table defining the new bit order (1-based, MSB first).
+ * @tparam TotalBits The total number of bits in the input.
+ * @param input The input data to permute.
+ * @return The permuted output data, identical to permute(input, Table, size of Table, TotalBits).
+ */
+template <const auto& Table, int TotalBits = 64>
+static inline uint64_t permute(uint64_t input) {
+    using Perm = StaticPermutation<Table, TotalBits>;
+    if constexpr (Perm::method == PERMUTE_BYTE_TABLES) {
+        return permuteBytes(input, permutationLUT<Table>(), std::make_index_sequence<TotalBits / 8>());
+    } else if constexpr (Perm::method == PERMUTE_DELTA_SWAPS) {
+        return permuteDeltaSwaps<Perm::program>(input, std::make_index_sequence<Perm::program.swap_count>());
+#if defined(__BMI2__)
+    } else if constexpr (Perm::method == PERMUTE_CHAINS) {
+        return permuteChains<Perm::program>(input, std::make_index_sequence<Perm::program.chain_count>());
+#endif
+    } else {
+        return permuteRotations<Perm::program>(input, std::make_index_sequence<Perm::program.rot_count>());
+    }
+}
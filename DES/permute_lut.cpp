@@ -0,0 +1,55 @@
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @brief Byte-indexed lookup tables for a DES permutation.
+ *
+ * Entry lut[b][v] holds the permuted output contributed by input byte b (b = 0 is the least
+ * significant byte) when that byte has the value v. A permutation is then the OR of one entry
+ * per input byte: 8 lookups for IP/FP, 7 for PC-2 and 4 for E and P.
+ */
+struct PermutationLUT {
+    int num_bytes;          // number of input bytes (total_bits / 8)
+    uint64_t lut[8][256];
+};
+
+/**
+ * @brief Build the lookup tables of a permutation table.
+ *
+ * @param perm The lookup tables to fill.
+ * @param table The permutation table defining the new bit order (1-based, MSB first).
+ * @param table_size The number of bits to permute.
+ * @param total_bits The total number of bits in the input (multiple of 8).
+ */
+static void buildPermutationLUT(PermutationLUT& perm, const int* table, int table_size, int total_bits) {
+    memset(perm.lut, 0, sizeof(perm.lut));
+    perm.num_bytes = total_bits / 8;
+
+    for (int i = 0; i < table_size; i++) {
+        // position of the source bit counted from the least significant bit
+        int src = total_bits - table[i];
+        int byte = src / 8;
+        uint8_t bit = 1 << (src % 8);
+        uint64_t out_bit = 1ULL << (table_size - 1 - i);
+
+        // every value of the source byte having this bit set contributes the output bit
+        for (int v = 0; v < 256; v++) {
+            if (v & bit) perm.lut[byte][v] |= out_bit;
+        }
+    }
+}
+
+/**
+ * @brief Table-driven permutation, one lookup per input byte.
+ *
+ * @param input The input data to permute.
+ * @param perm The lookup tables built by buildPermutationLUT().
+ * @return The permuted output data, identical to the bit-by-bit permute().
+ */
+static inline uint64_t permute(uint64_t input, const PermutationLUT& perm) {
+    uint64_t output = 0;
+    for (int b = 0; b < perm.num_bytes; b++) {
+        output |= perm.lut[b][(input >> (8 * b)) & 0xFF];
+    }
+    return output;
+}
@@ -0,0 +1,285 @@
+// Bitsliced known-plaintext key search.
+//
+// Every lane of the planes tries its own key on the same plaintext block: the plaintext planes are
+// constants and the key planes are built from the index of the keys, so nothing is transposed. The
+// batches are visited in Gray-code order, from one batch to the next a single key plane is complemented.
+// A batch stops after the first S-boxes of round 15 once every lane has a wrong bit of R15, which the
+// ciphertext gives as L16, and round 16 is never computed. The few keys left are verified with the
+// scalar DES on every known pair.
+//
+// Uses the bitsliced engine, so it is included after des.cpp.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief Keys to enumerate: the known bits of a key and the free bits, whose values form the index.
+ */
+struct SearchSpace {
+    uint64_t key;         // the known bits, the others are ignored
+    uint64_t mask;        // known bits set, DES bit 1 is the most significant bit
+    int num_free;         // number of free bits, the parity bits are never enumerated
+    int free_bits[56];    // key bit (MSB first) holding bit b of the index, least significant first
+    int free_index[64];   // index bit held by each key bit (MSB first), -1 if it is known
+
+    uint64_t size() const { return uint64_t(1) << num_free; }
+};
+
+/**
+ * @brief A known plaintext and ciphertext pair, prepared for the search kernels.
+ */
+struct SearchBlock {
+    uint64_t lr[64];   // L0 and R0 after IP, one mask per bit (all ones if the bit is set)
+    uint64_t r15[32];  // R15, which is L16 after IP of the ciphertext, one mask per bit
+};
+
+/**
+ * @brief Fill a search space.
+ *
+ * @param space The space to fill.
+ * @param key The known bits.
+ * @param mask The known bits set, the parity bits (DES bits 8, 16, ..., 64) are ignored.
+ */
+void buildSearchSpace(SearchSpace& space, uint64_t key, uint64_t mask) {
+    space.key = key;
+    space.mask = mask;
+    space.num_free = 0;
+    for (int p = 63; p >= 0; p--) {
+        bool known = ((mask >> (63 - p)) & 0x01) || (p % 8 == 7);
+        space.free_index[p] = known ? -1 : space.num_free;
+        if (!known) space.free_bits[space.num_free++] = p;
+    }
+}
+
+/**
+ * @brief Key at an index of a search space.
+ */
+uint64_t searchKeyAt(const SearchSpace& space, uint64_t index) {
+    uint64_t key = space.key;
+    for (int b = 0; b < space.num_free; b++) {
+        uint64_t bit = uint64_t(1) << (63 - space.free_bits[b]);
+        key = ((index >> b) & 0x01) ? (key | bit) : (key & ~bit);
+    }
+    return key;
+}
+
+/**
+ * @brief Prepare a plaintext and ciphertext pair for the search kernels.
+ */
+void buildSearchBlock(SearchBlock& block, uint64_t plaintext, uint64_t ciphertext) {
+    // the ciphertext is FP(R16 L16), so IP gives R16 L16 back, and R15 = L16
+    uint64_t lr = permute<IP_t>(plaintext);
+    uint64_t rl = permute<IP_t>(ciphertext);
+    for (int i = 0; i < 64; i++) {
+        block.lr[i] = 0 - ((lr >> (63 - i)) & 0x01);
+    }
+    for (int i = 0; i < 32; i++) {
+        block.r15[i] = 0 - ((rl >> (31 - i)) & 0x01);
+    }
+}
+
+/**
+ * @brief Check a key against known pairs with the scalar DES.
+ *
+ * @param key The key.
+ * @param pairs Plaintext and ciphertext of each pair, 2 * count values.
+ * @param count Number of pairs.
+ * @return true if the key encrypts every plaintext into its ciphertext, false otherwise.
+ */
+bool verifySearchKey(uint64_t key, const uint64_t* pairs, size_t count) {
+    KeySchedule schedule;
+    buildKeySchedule(schedule, key);
+    for (size_t i = 0; i < count; i++) {
+        if (DES<DES_ENCRYPT>(pairs[2 * i], schedule) != pairs[2 * i + 1]) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Check if every lane of a plane is all ones.
+ */
+template <typename T>
+bs_inline bool bsAllOnes(const T& x) {
+    if constexpr (std::is_integral<T>::value) {
+        return x == ~uint64_t(0);
+    } else {
+        uint64_t words[sizeof(T) / 8];
+        memcpy(words, &x, sizeof(T));
+        uint64_t all = ~uint64_t(0);
+        for (uint64_t w : words) all &= w;
+        return all == ~uint64_t(0);
+    }
+}
+
+/**
+ * @brief Key planes of the batches of a search task, visited in Gray-code order.
+ *
+ * Bits 0 to 5 of the index select the bit of a lane word and the next bits select the lane, so their planes
+ * never change. The higher bits number the batches, which are visited in Gray-code order: from one batch to
+ * the next, a single index bit changes and its key plane is complemented.
+ */
+struct SearchKeyPlanes {
+    alignas(64) uint64_t words[64 * 8];  // plane p of lane w at words[p * lanes + w]
+    int lanes;                           // 64-bit lanes of the kernel, 1, 4 or 8
+    int batch_bits;                      // index bits inside a batch
+    uint64_t batch;                      // index of the first key of the current batch
+    uint64_t step;                       // batches visited since start()
+
+    /**
+     * @brief Build the planes of a first batch.
+     *
+     * @param space The search space.
+     * @param num_lanes 64-bit lanes of the kernel.
+     * @param first Index of the first key of the batch, a multiple of 64 * num_lanes.
+     */
+    void start(const SearchSpace& space, int num_lanes, uint64_t first) {
+        // index bits 0 to 5 select the bit of a lane word
+        constexpr uint64_t bit_patterns[6] = {0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+                                              0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL};
+        lanes = num_lanes;
+        batch_bits = 6 + __builtin_ctz(lanes);
+        batch = first;
+        step = 0;
+
+        for (int p = 0; p < 64; p++) {
+            int b = space.free_index[p];
+            for (int w = 0; w < lanes; w++) {
+                uint64_t& word = words[p * lanes + w];
+                if (b < 0) {
+                    word = 0 - ((space.key >> (63 - p)) & 0x01);
+                } else if (b < 6) {
+                    word = bit_patterns[b];
+                } else if (b < batch_bits) {
+                    word = 0 - ((static_cast<uint64_t>(w) >> (b - 6)) & 0x01);
+                } else {
+                    word = 0 - ((first >> b) & 0x01);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Move to the next batch in Gray-code order, within the aligned block of batches of the first one.
+     */
+    void next(const SearchSpace& space) {
+        int b = batch_bits + __builtin_ctzll(++step);
+        batch ^= uint64_t(1) << b;
+        uint64_t* plane = words + space.free_bits[b] * lanes;
+        for (int w = 0; w < lanes; w++) {
+            plane[w] = ~plane[w];
+        }
+    }
+};
+
+/**
+ * @brief One S-box of round 15, then compare its 4 bits of R15 with the expected ones.
+ *
+ * @return false once every lane has a wrong bit.
+ */
+template <int N, typename T>
+bs_inline bool searchSBox(T* L, const T* R, const T* K, const T* expected, T& mismatch) {
+    bitsliceSBox<N>(L, R, K);
+    for (int k = 0; k < 4; k++) {
+        int bit = P_inv.v[4 * N + k];
+        mismatch |= L[bit] ^ expected[bit];
+    }
+    // 4 bits rarely reject every lane, checking from the second S-box on
+    return N == 0 || !bsAllOnes(mismatch);
+}
+
+template <typename T, size_t... N>
+bs_inline void searchRound(T* L, const T* R, const T* K, const T* expected, T& mismatch, std::index_sequence<N...>) {
+    (searchSBox<N>(L, R, K, expected, mismatch) && ...);
+}
+
+/**
+ * @brief Try a batch of 64 * (sizeof(T) / 8) keys of a search space on a known pair.
+ *
+ * @param planes Key planes of the batch, with sizeof(T) / 8 lanes.
+ * @param block The known pair.
+ * @param candidates sizeof(T) / 8 words, bit t of word w is set if the key at index planes.batch + 64 * w + t
+ *                   gives the expected R15.
+ */
+template <typename T>
+bs_inline void searchBatch(const SearchKeyPlanes& planes, const SearchBlock& block, uint64_t* candidates) {
+    // the words of a plane are contiguous and aligned for T
+    LaneRoundKeys<T> round_keys{reinterpret_cast<const T*>(planes.words), false};
+
+    // the plaintext is the same in every lane
+    T L[32], R[32], expected[32];
+    for (int i = 0; i < 32; i++) {
+        bsSplat(L[i], block.lr[i]);
+        bsSplat(R[i], block.lr[32 + i]);
+        bsSplat(expected[i], block.r15[i]);
+    }
+
+    // rounds 1 to 14 leave L14 in L and R14 in R
+    T K[48];
+    for (int i = 0; i < 14; i += 2) {
+        round_keys.load(i, K);
+        bitsliceRound(L, R, K, std::make_index_sequence<8>());
+
+        round_keys.load(i + 1, K);
+        bitsliceRound(R, L, K, std::make_index_sequence<8>());
+    }
+
+    // round 15 turns L into R15
+    T mismatch;
+    bsSplat(mismatch, 0);
+    round_keys.load(14, K);
+    searchRound(L, R, K, expected, mismatch, std::make_index_sequence<8>());
+
+    T hits = ~mismatch;
+    memcpy(candidates, &hits, sizeof(T));
+}
+
+/**
+ * @brief Portable 64-key search batch.
+ */
+void search64(const SearchKeyPlanes& planes, const SearchBlock& block, uint64_t* candidates) {
+    searchBatch<uint64_t>(planes, block, candidates);
+}
+
+/**
+ * @brief AVX2 256-key search batch.
+ */
+__attribute__((target("avx2"), flatten))
+void search256(const SearchKeyPlanes& planes, const SearchBlock& block, uint64_t* candidates) {
+    searchBatch<__m256i>(planes, block, candidates);
+}
+
+/**
+ * @brief AVX-512 512-key search batch.
+ */
+__attribute__((target("avx512f"), flatten))
+void search512(const SearchKeyPlanes& planes, const SearchBlock& block, uint64_t* candidates) {
+    searchBatch<__m512i>(planes, block, candidates);
+}
+
+/**
+ * @brief A search kernel and the number of keys it tries per call, named after its bitsliced kernel.
+ */
+struct SearchKernel {
+    const char* name;
+    size_t keys;
+    void (*run)(const SearchKeyPlanes& planes, const SearchBlock& block, uint64_t* candidates);
+};
+
+const SearchKernel search_kernels[] = {
+    {"avx512", 512, search512},
+    {"avx2", 256, search256},
+    {"portable", 64, search64},
+};
+
+/**
+ * @brief Search kernel on the instruction set of a bitsliced kernel.
+ */
+const SearchKernel* selectSearchKernel(const BitsliceKernel* kernel) {
+    for (const SearchKernel& search_kernel : search_kernels) {
+        if (strcmp(search_kernel.name, kernel->name) == 0) return &search_kernel;
+    }
+    return &search_kernels[2];
+}
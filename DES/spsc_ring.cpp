@@ -0,0 +1,113 @@
+#include <stddef.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/**
+ * @brief Lock-free ring buffer between one producer thread and one consumer thread.
+ *
+ * @tparam T Type of the items, copied in and out of the ring.
+ * @tparam Capacity Number of slots, a power of two.
+ *
+ * The producer only writes tail and the consumer only writes head, each on its own cache line.
+ * push() and pop() yield a bounded number of times while the ring is full or empty, then sleep on a
+ * condition variable until the other side makes progress. A side only takes the mutex to wake the
+ * other one when it is asleep.
+ */
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    /**
+     * @brief Add an item if there is room, producer side.
+     *
+     * @return true if the item was added, false if the ring is full.
+     */
+    bool tryPush(const T& item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == Capacity) return false;
+        slots[t & (Capacity - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Take the oldest item if there is one, consumer side.
+     *
+     * @return true if an item was taken, false if the ring is empty.
+     */
+    bool tryPop(T& item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (tail.load(std::memory_order_acquire) == h) return false;
+        item = slots[h & (Capacity - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Add an item, waiting while the ring is full, producer side.
+     */
+    void push(const T& item) {
+        for (int spins = 0; !tryPush(item); spins++) {
+            if (spins < spin_limit) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(wait_mutex);
+            producer_waiting.store(true);
+            wait_cv.wait(lock, [this] { return tail.load(std::memory_order_relaxed) - head.load() != Capacity; });
+            producer_waiting.store(false, std::memory_order_relaxed);
+        }
+        wake(consumer_waiting);
+    }
+
+    /**
+     * @brief Take the oldest item, waiting while the ring is empty, consumer side.
+     */
+    T pop() {
+        T item;
+        for (int spins = 0; !tryPop(item); spins++) {
+            if (spins < spin_limit) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(wait_mutex);
+            consumer_waiting.store(true);
+            wait_cv.wait(lock, [this] { return tail.load() != head.load(std::memory_order_relaxed); });
+            consumer_waiting.store(false, std::memory_order_relaxed);
+        }
+        wake(producer_waiting);
+        return item;
+    }
+
+private:
+    // yields before a blocked side goes to sleep
+    static constexpr int spin_limit = 64;
+
+    /**
+     * @brief Wake the other side if it sleeps, after this side moved head or tail.
+     *
+     * The fence orders the index store before the load of the flag, and the sleeping side sets its flag
+     * before it reads the index again, so one of them sees the other.
+     */
+    void wake(const std::atomic<bool>& waiting) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(wait_mutex);
+            wait_cv.notify_all();
+        }
+    }
+
+    alignas(64) std::atomic<size_t> head{0};  // next slot to pop
+    alignas(64) std::atomic<size_t> tail{0};  // next slot to push
+    alignas(64) T slots[Capacity];
+
+    // sleeping sides, only touched once the spins are exhausted
+    alignas(64) std::atomic<bool> producer_waiting{false};
+    std::atomic<bool> consumer_waiting{false};
+    std::mutex wait_mutex;
+    std::condition_variable wait_cv;
+};
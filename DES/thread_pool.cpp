@@ -0,0 +1,155 @@
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Persistent pool of worker threads with work stealing.
+ *
+ * Every worker owns a task queue. submit() spreads the tasks over the queues round-robin, a worker
+ * takes the newest task of its own queue and, when it is empty, steals the oldest task of another
+ * queue. The thread calling wait() runs tasks too, so a pool of N threads starts N - 1 workers.
+ * Once no task is left to start, wait() yields a bounded number of times for the running ones, then
+ * sleeps until the last one finishes.
+ */
+class ThreadPool {
+public:
+    /**
+     * @brief Start the workers.
+     *
+     * @param num_threads Total number of threads running tasks, including the one calling wait().
+     */
+    explicit ThreadPool(unsigned num_threads) : queues(num_threads > 0 ? num_threads : 1) {
+        for (unsigned i = 1; i < queues.size(); i++) {
+            workers.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            stopping = true;
+        }
+        sleep_cv.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Number of threads running tasks, including the one calling wait().
+     */
+    unsigned size() const { return static_cast<unsigned>(queues.size()); }
+
+    /**
+     * @brief Queue a task.
+     *
+     * @param task The task, it may be run by any thread of the pool.
+     */
+    void submit(std::function<void()> task) {
+        pending.fetch_add(1);
+        queued.fetch_add(1);
+        TaskQueue& queue = queues[next_queue.fetch_add(1) % queues.size()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        {
+            // an idle worker either sees the new count or is already waiting for the notification
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+        }
+        sleep_cv.notify_one();
+    }
+
+    /**
+     * @brief Run tasks until every submitted task is done.
+     */
+    void wait() {
+        int spins = 0;
+        while (pending.load() > 0) {
+            if (runOneTask(0)) {
+                spins = 0;
+            } else if (spins++ < spin_limit) {
+                std::this_thread::yield();
+            } else {
+                // the last tasks run on the workers, the one finishing them notifies
+                std::unique_lock<std::mutex> lock(sleep_mutex);
+                done_cv.wait(lock, [this] { return pending.load() == 0; });
+            }
+        }
+    }
+
+private:
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<TaskQueue> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> next_queue{0};
+    std::atomic<size_t> pending{0};  // submitted and not finished
+    std::atomic<size_t> queued{0};   // submitted and not started
+
+    // yields of wait() before it sleeps on done_cv
+    static constexpr int spin_limit = 64;
+
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_cv;
+    std::condition_variable done_cv;  // notified when pending drops to 0
+    bool stopping = false;
+
+    /**
+     * @brief Take a task from the own queue of a thread, or steal one from another queue.
+     */
+    bool takeTask(unsigned self, std::function<void()>& task) {
+        {
+            TaskQueue& own = queues[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                queued.fetch_sub(1);
+                return true;
+            }
+        }
+        for (size_t k = 1; k < queues.size(); k++) {
+            TaskQueue& victim = queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                queued.fetch_sub(1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool runOneTask(unsigned self) {
+        std::function<void()> task;
+        if (!takeTask(self, task)) return false;
+        task();
+        if (pending.fetch_sub(1) == 1) {
+            // wait() either sees the new count or is already waiting for the notification
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            done_cv.notify_all();
+        }
+        return true;
+    }
+
+    void workerLoop(unsigned self) {
+        while (true) {
+            if (runOneTask(self)) continue;
+
+            // sleep until new work arrives
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            sleep_cv.wait(lock, [this] { return stopping || queued.load() > 0; });
+            if (stopping) return;
+        }
+    }
+};
@@ -0,0 +1,443 @@
+// Microbenchmarks of the hot-path primitives and kernels of the DES engine, printed as JSON.
+//
+// Every benchmark calls its function in a loop, doubling the number of calls until a sample lasts long
+// enough, and keeps the fastest of several samples. Scalar primitives are chained (each call takes the
+// result of the previous one), so they report latency; the kernels run on a buffer of 4096 blocks, which
+// stays in the L2 cache, and report throughput. Cycles are read from the time stamp counter.
+//
+//   g++ -O2 -std=c++17 bench/bench_des.cpp -o bench_des
+//   ./bench_des [--filter=<substring>] [--min-time=<seconds>] > results.json
+//
+// The scalar kernel is benchmarked with every interleave factor, whatever DES_INTERLEAVE is set to.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <x86intrin.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// DES engine, and the search kernels built on it
+#include "../DES/des.cpp"
+#include "../DES/search.cpp"
+
+using namespace std;
+
+// blocks processed per call by the kernel benchmarks, 32 KiB
+const size_t bench_blocks = 4096;
+
+// samples per benchmark, the fastest one is kept
+const int bench_samples = 5;
+
+/**
+ * @brief Result of a benchmark.
+ */
+struct BenchResult {
+    string name;
+    size_t bytes;           // bytes processed per call
+    size_t items;           // blocks or keys processed per call
+    uint64_t calls;         // calls of the fastest sample
+    double ns_per_call;
+    double cycles_per_call;
+};
+
+// options
+string filter;          // --filter, run the benchmarks whose name contains it
+double min_time = 0.5;  // --min-time, seconds per benchmark
+
+vector<BenchResult> results;
+
+/**
+ * @brief Keep the compiler from optimizing a value away or computing it out of the loop.
+ */
+template <typename T>
+inline void keep(T& value) {
+    asm volatile("" : "+r,m"(value) : : "memory");
+}
+
+/**
+ * @brief Run a benchmark and record its result.
+ *
+ * @param name Name of the benchmark, as printed.
+ * @param bytes Bytes processed per call.
+ * @param items Blocks or keys processed per call.
+ * @param body Callable taking the number of calls to make.
+ */
+template <typename Body>
+void runBenchmark(const string& name, size_t bytes, size_t items, Body body) {
+    if (!filter.empty() && name.find(filter) == string::npos) return;
+
+    // double the calls until a sample lasts min_time / bench_samples
+    double sample_time = min_time / bench_samples;
+    uint64_t calls = 1;
+    BenchResult result{name, bytes, items, 0, 0, 0};
+    for (int sample = 0; sample < bench_samples;) {
+        auto start = chrono::steady_clock::now();
+        uint64_t start_cycles = __rdtsc();
+        body(calls);
+        uint64_t cycles = __rdtsc() - start_cycles;
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        if (seconds < sample_time) {
+            calls *= 2;
+            continue;
+        }
+        double ns_per_call = seconds * 1e9 / calls;
+        if (result.calls == 0 || ns_per_call < result.ns_per_call) {
+            result.calls = calls;
+            result.ns_per_call = ns_per_call;
+            result.cycles_per_call = double(cycles) / calls;
+        }
+        sample++;
+    }
+    results.push_back(result);
+    cerr << name << ": " << result.ns_per_call << " ns/call" << endl;
+}
+
+/**
+ * @brief Benchmark the three implementations of a permutation table.
+ */
+template <const auto& Table, int TotalBits>
+void benchPermutation(const char* table_name, const PermutationLUT& lut) {
+    const int table_size = sizeof(Table) / sizeof(Table[0]);
+    const size_t bytes = TotalBits / 8;
+
+    runBenchmark(string("permute/generic/") + table_name, bytes, 1, [&](uint64_t calls) {
+        uint64_t x = 0x0123456789ABCDEF;
+        for (uint64_t i = 0; i < calls; i++) {
+            x = permute(x, Table, table_size, TotalBits) ^ i;
+            keep(x);
+        }
+    });
+    runBenchmark(string("permute/lut/") + table_name, bytes, 1, [&](uint64_t calls) {
+        uint64_t x = 0x0123456789ABCDEF;
+        for (uint64_t i = 0; i < calls; i++) {
+            x = permute(x, lut) ^ i;
+            keep(x);
+        }
+    });
+    runBenchmark(string("permute/compile_time/") + table_name, bytes, 1, [&](uint64_t calls) {
+        uint64_t x = 0x0123456789ABCDEF;
+        for (uint64_t i = 0; i < calls; i++) {
+            x = permute<Table, TotalBits>(x) ^ i;
+            keep(x);
+        }
+    });
+}
+
+/**
+ * @brief Benchmark the permutations, the S-boxes, a round and the DES function on one block.
+ */
+void benchScalar(const KeySchedule& schedule) {
+    benchPermutation<pc_1, 64>("pc_1", pc_1_lut);
+    benchPermutation<pc_2, 56>("pc_2", pc_2_lut);
+    benchPermutation<IP_t, 64>("IP", IP_lut);
+    benchPermutation<P_1, 64>("FP", P_1_lut);
+    benchPermutation<E_t, 32>("E", E_lut);
+    benchPermutation<P, 32>("P", P_lut);
+
+    runBenchmark("SBox_n", 1, 1, [](uint64_t calls) {
+        uint8_t x = 0x2A;
+        for (uint64_t i = 0; i < calls; i++) {
+            x = SBox_n((x ^ i) & 0x3F, S1);
+            keep(x);
+        }
+    });
+    runBenchmark("SBox", 6, 1, [](uint64_t calls) {
+        uint64_t x = 0x0123456789AB;
+        for (uint64_t i = 0; i < calls; i++) {
+            x = (SBox(x) ^ i) & 0xFFFFFFFFFFFF;
+            keep(x);
+        }
+    });
+    runBenchmark("SPBox", 6, 1, [](uint64_t calls) {
+        uint64_t x = 0x0123456789AB;
+        for (uint64_t i = 0; i < calls; i++) {
+            x = (SPBox(x) ^ i) & 0xFFFFFFFFFFFF;
+            keep(x);
+        }
+    });
+    runBenchmark("DES_round", 4, 1, [&](uint64_t calls) {
+        uint64_t r = 0x01234567;
+        for (uint64_t i = 0; i < calls; i++) {
+            r = DES_round(r, schedule.forward[i & 15]);
+            keep(r);
+        }
+    });
+    runBenchmark("DES", 8, 1, [&](uint64_t calls) {
+        uint64_t block = 0x0123456789ABCDEF;
+        for (uint64_t i = 0; i < calls; i++) {
+            block = DES(block, schedule.forward);
+            keep(block);
+        }
+    });
+}
+
+/**
+ * @brief Benchmark the key schedules: the tables behind buildKeySchedule() against the serial reference.
+ */
+void benchKeySchedule() {
+    runBenchmark("key_schedule/tables", 8, 1, [](uint64_t calls) {
+        KeySchedule schedule;
+        uint64_t key = 0x133457799BBCDFF1;
+        for (uint64_t i = 0; i < calls; i++) {
+            buildKeySchedule(schedule, key);
+            keep(schedule);
+            key = schedule.forward[i & 15] ^ i;
+        }
+    });
+    runBenchmark("key_schedule/serial", 8, 1, [](uint64_t calls) {
+        KeySchedule schedule;
+        uint64_t key = 0x133457799BBCDFF1;
+        for (uint64_t i = 0; i < calls; i++) {
+            buildKeyScheduleSerial(schedule, key);
+            keep(schedule);
+            key = schedule.forward[i & 15] ^ i;
+        }
+    });
+    runBenchmark("key_schedule/flip_bit", 8, 1, [](uint64_t calls) {
+        KeySchedule schedule;
+        buildKeySchedule(schedule, 0x133457799BBCDFF1);
+        for (uint64_t i = 0; i < calls; i++) {
+            flipKeyBit(schedule, __builtin_ctzll(i + 1) % 64);
+            keep(schedule);
+        }
+    });
+}
+
+/**
+ * @brief Benchmark the kernels on a buffer of bench_blocks blocks.
+ */
+void benchKernels(const KeySchedule& schedule) {
+    vector<uint64_t> buffer(bench_blocks + 8);
+    // aligned for the SIMD kernels
+    uint64_t* blocks = buffer.data() + (8 - reinterpret_cast<uintptr_t>(buffer.data()) / 8 % 8) % 8;
+    for (size_t i = 0; i < bench_blocks; i++) blocks[i] = i * 0x9E3779B97F4A7C15ULL;
+    const size_t bytes = bench_blocks * 8;
+
+    // the byte order conversion of a whole buffer, the kernels fold it into their loads and stores
+    runBenchmark("swapEndianness/array", bytes, bench_blocks, [&](uint64_t calls) {
+        for (uint64_t c = 0; c < calls; c++) {
+            for (size_t i = 0; i < bench_blocks; i++) blocks[i] = swapEndianness(blocks[i]);
+            keep(blocks);
+        }
+    });
+
+    runBenchmark("DES_interleaved/2", bytes, bench_blocks, [&](uint64_t calls) {
+        for (uint64_t c = 0; c < calls; c++) {
+            for (size_t i = 0; i < bench_blocks; i += 2) DES_interleaved<2>(blocks + i, schedule.forward);
+            keep(blocks);
+        }
+    });
+    runBenchmark("DES_interleaved/4", bytes, bench_blocks, [&](uint64_t calls) {
+        for (uint64_t c = 0; c < calls; c++) {
+            for (size_t i = 0; i < bench_blocks; i += 4) DES_interleaved<4>(blocks + i, schedule.forward);
+            keep(blocks);
+        }
+    });
+    runBenchmark("DES_interleaved/8", bytes, bench_blocks, [&](uint64_t calls) {
+        for (uint64_t c = 0; c < calls; c++) {
+            for (size_t i = 0; i < bench_blocks; i += 8) DES_interleaved<8>(blocks + i, schedule.forward);
+            keep(blocks);
+        }
+    });
+
+    if (__builtin_cpu_supports("avx2")) {
+        GatherKeys gather_keys;
+        buildGatherKeys(gather_keys, schedule.forward);
+        runBenchmark("gather8", bytes, bench_blocks, [&](uint64_t calls) {
+            for (uint64_t c = 0; c < calls; c++) {
+                for (size_t i = 0; i < bench_blocks; i += 8) DES_gather8(blocks + i, gather_keys);
+                keep(blocks);
+            }
+        });
+    }
+
+    vector<uint64_t> key_buffer(bench_blocks + 8);
+    uint64_t* keys = key_buffer.data() + (8 - reinterpret_cast<uintptr_t>(key_buffer.data()) / 8 % 8) % 8;
+    for (size_t i = 0; i < bench_blocks; i++) keys[i] = i * 0xD1B54A32D192ED03ULL;
+
+    for (const BitsliceKernel& kernel : bitslice_kernels) {
+        if (!bitsliceKernelSupported(kernel)) continue;
+
+        KernelKeys kernel_keys;
+        prepareKernelKeys(kernel_keys, &kernel, schedule.forward);
+        runBenchmark(string("bitslice/") + kernel.name, bytes, bench_blocks, [&](uint64_t calls) {
+            for (uint64_t c = 0; c < calls; c++) {
+                for (size_t i = 0; i < bench_blocks; i += kernel.blocks) kernel.run(blocks + i, kernel_keys.bitslice);
+                keep(blocks);
+            }
+        });
+        runBenchmark(string("bitslice_keys/") + kernel.name, bytes, bench_blocks, [&](uint64_t calls) {
+            for (uint64_t c = 0; c < calls; c++) {
+                for (size_t i = 0; i < bench_blocks; i += kernel.blocks) kernel.run_keys(blocks + i, keys + i, false);
+                keep(blocks);
+            }
+        });
+        runBenchmark(string("ctr/") + kernel.name, bytes, bench_blocks, [&](uint64_t calls) {
+            for (uint64_t c = 0; c < calls; c++) {
+                ctrBlocks(blocks, blocks, bytes, c * bench_blocks, kernel_keys);
+                keep(blocks);
+            }
+        });
+        runBenchmark(string("cbc_decrypt/") + kernel.name, bytes, bench_blocks, [&](uint64_t calls) {
+            for (uint64_t c = 0; c < calls; c++) {
+                cbcDecryptBlocks(blocks, bench_blocks, c, kernel_keys);
+                keep(blocks);
+            }
+        });
+
+        // the CBC encryption of the buffer as one chain, which runs on the scalar DES whatever the kernel, then
+        // as cbc_streams chains of bench_blocks / cbc_streams blocks encrypted together
+        const size_t cbc_streams = 512;
+        CbcStream streams[cbc_streams];
+        for (size_t s = 0; s < cbc_streams; s++) {
+            streams[s] = {blocks + s * (bench_blocks / cbc_streams), bench_blocks / cbc_streams, s};
+        }
+        runBenchmark(string("cbc_encrypt/1/") + kernel.name, bytes, bench_blocks, [&](uint64_t calls) {
+            CbcStream stream{blocks, bench_blocks, 0};
+            for (uint64_t c = 0; c < calls; c++) {
+                cbcEncryptStreams(&stream, 1, kernel_keys);
+                keep(blocks);
+            }
+        });
+        runBenchmark(string("cbc_encrypt/") + to_string(cbc_streams) + "/" + kernel.name, bytes, bench_blocks,
+                     [&](uint64_t calls) {
+            for (uint64_t c = 0; c < calls; c++) {
+                cbcEncryptStreams(streams, cbc_streams, kernel_keys);
+                keep(blocks);
+            }
+        });
+
+        KernelKeys triple_keys;
+        DesKey triple_key(0x0123456789ABCDEF, 0x23456789ABCDEF01, 0x456789ABCDEF0123);
+        prepareKernelKeys(triple_keys, &kernel, triple_key.encryption_keys(), triple_key.stages());
+        runBenchmark(string("triple_des/") + kernel.name, bytes, bench_blocks, [&](uint64_t calls) {
+            for (uint64_t c = 0; c < calls; c++) {
+                processBlocks(blocks, bench_blocks, triple_keys);
+                keep(blocks);
+            }
+        });
+
+        // a key per block through the public API, with the tiles and the byte order of processBlocksMultiKey()
+        DesMultiKey multi_key(kernel.name);
+        runBenchmark(string("multi_key/") + kernel.name, bytes, bench_blocks, [&](uint64_t calls) {
+            for (uint64_t c = 0; c < calls; c++) {
+                multi_key.encrypt_blocks(keys, blocks, blocks, bench_blocks);
+                keep(blocks);
+            }
+        });
+    }
+}
+
+/**
+ * @brief Benchmark the key search kernels, a call tries a batch of keys on one known pair.
+ */
+void benchSearch() {
+    SearchSpace space;
+    buildSearchSpace(space, 0, 0);
+    SearchBlock block;
+    buildSearchBlock(block, 0x0123456789ABCDEF, 0x85E813540F0AB405);
+
+    for (const SearchKernel& search_kernel : search_kernels) {
+        if (selectBitsliceKernel(search_kernel.name) == nullptr) continue;
+        SearchKeyPlanes planes;
+        planes.start(space, search_kernel.keys / 64, 0);
+        runBenchmark(string("search/") + search_kernel.name, 8 * search_kernel.keys, search_kernel.keys,
+                     [&](uint64_t calls) {
+            uint64_t candidates[8];
+            uint64_t* hits = candidates;
+            for (uint64_t c = 0; c < calls; c++) {
+                search_kernel.run(planes, block, hits);
+                keep(hits);
+                planes.next(space);
+            }
+        });
+    }
+}
+
+/**
+ * @brief Escape a string for JSON.
+ */
+string jsonString(const string& value) {
+    string escaped = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20) escaped += c;
+    }
+    return escaped + "\"";
+}
+
+/**
+ * @brief Model name of the host CPU, empty if unknown.
+ */
+string cpuModel() {
+    ifstream cpuinfo("/proc/cpuinfo");
+    string line;
+    while (getline(cpuinfo, line)) {
+        if (line.compare(0, 10, "model name") == 0) {
+            size_t colon = line.find(':');
+            if (colon != string::npos) return line.substr(line.find_first_not_of(' ', colon + 1));
+        }
+    }
+    return "";
+}
+
+/**
+ * @brief Print the host, the build and the results as JSON.
+ */
+void printResults() {
+    cout << "{\n";
+    cout << "  \"host\": {\"cpu\": " << jsonString(cpuModel()) << ", \"avx2\": "
+         << (__builtin_cpu_supports("avx2") ? "true" : "false") << ", \"avx512f\": "
+         << (__builtin_cpu_supports("avx512f") ? "true" : "false") << "},\n";
+    cout << "  \"build\": {\"compiler\": " << jsonString(__VERSION__) << ", \"des_interleave\": " << DES_INTERLEAVE
+         << "},\n";
+    cout << "  \"cycle_counter\": \"tsc\",\n";
+    cout << "  \"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        char line[512];
+        snprintf(line, sizeof(line),
+                 "%s\n    {\"name\": %s, \"bytes_per_call\": %zu, \"items_per_call\": %zu, \"calls\": %llu, "
+                 "\"ns_per_call\": %.3f, \"cycles_per_call\": %.2f, \"cycles_per_byte\": %.3f, "
+                 "\"items_per_second\": %.0f}",
+                 i ? "," : "", jsonString(r.name).c_str(), r.bytes, r.items, (unsigned long long)r.calls,
+                 r.ns_per_call, r.cycles_per_call, r.cycles_per_call / r.bytes, r.items * 1e9 / r.ns_per_call);
+        cout << line;
+    }
+    cout << "\n  ]\n}" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.compare(0, 9, "--filter=") == 0) {
+            filter = arg.substr(9);
+        } else if (arg.compare(0, 11, "--min-time=") == 0 && atof(arg.c_str() + 11) > 0) {
+            min_time = atof(arg.c_str() + 11);
+        } else {
+            cerr << "\033[31mUsage: bench_des [--filter=<substring>] [--min-time=<seconds>]\033[0m" << endl;
+            return 1;
+        }
+    }
+
+    initPermutationTables();
+    __builtin_cpu_init();
+    KeySchedule schedule;
+    buildKeySchedule(schedule, 0x133457799BBCDFF1);
+
+    benchScalar(schedule);
+    benchKeySchedule();
+    benchKernels(schedule);
+    benchSearch();
+
+    printResults();
+    return 0;
+}
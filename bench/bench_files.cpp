@@ -0,0 +1,391 @@
+// End-to-end benchmark of the command line tool: files are read, encrypted or decrypted and written by the
+// tool itself, run as a child process for every dataset size, I/O path, thread count and cache state.
+//
+// The datasets are generated once, deterministically, and kept in the dataset directory. The warm runs
+// read the input once before they are timed; the cold runs drop the page cache first, through
+// /proc/sys/vm/drop_caches if it is writable (root), else by advising the kernel to evict the input file.
+// Every run reports its throughput (input bytes over the wall time of the process), its peak RSS, and the
+// time spent in the cipher, from --stats, against the rest (I/O, allocation, key setup), as JSON.
+//
+//   g++ -O2 -std=c++17 -pthread DES/main.cpp -o des
+//   g++ -O2 -std=c++17 bench/bench_files.cpp -o bench_files
+//   ./bench_files --cli=./des --dir=/tmp/des-bench --sizes=4K,1M,64M,1G,16G > results.json
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// options
+string cli_path = "./des";          // --cli
+string data_dir = "des-bench";      // --dir
+vector<uint64_t> dataset_sizes;     // --sizes
+vector<unsigned> thread_counts;     // --threads
+vector<string> io_paths = {"read", "stream", "mmap", "io-uring"};  // --paths
+bool run_warm = true, run_cold = true;                            // --cache=warm|cold|both
+
+// key of every run, a fixed DES key
+const unsigned char bench_key[8] = {0x13, 0x34, 0x57, 0x79, 0x9B, 0xBC, 0xDF, 0xF1};
+
+// bytes generated or compared at once
+const size_t io_chunk_size = 1 << 20;
+
+/**
+ * @brief Result of a run of the command line tool.
+ */
+struct RunResult {
+    bool ok;
+    double wall_seconds;     // fork to exit, as seen by the driver
+    double tool_seconds;     // elapsed time reported by --stats
+    double cipher_seconds;   // time in the cipher, reported by --stats
+    double user_seconds, system_seconds;
+    long peak_rss_kb;
+    string error;            // standard error of the tool if it failed
+};
+
+/**
+ * @brief Parse a size with an optional K, M or G suffix.
+ *
+ * @return false if it is not a size.
+ */
+bool parseSize(const string& text, uint64_t& size) {
+    size_t digits = text.find_first_not_of("0123456789");
+    if (digits == 0 || text.empty()) return false;
+    size = stoull(text.substr(0, digits));
+    string suffix = digits == string::npos ? "" : text.substr(digits);
+    if (suffix == "K") size <<= 10;
+    else if (suffix == "M") size <<= 20;
+    else if (suffix == "G") size <<= 30;
+    else if (!suffix.empty()) return false;
+    return size > 0;
+}
+
+/**
+ * @brief Format a size with the largest exact suffix, as in the dataset names.
+ */
+string sizeName(uint64_t size) {
+    const char* suffixes[] = {"", "K", "M", "G"};
+    int s = 0;
+    while (s < 3 && size % 1024 == 0) {
+        size /= 1024;
+        s++;
+    }
+    return to_string(size) + suffixes[s];
+}
+
+/**
+ * @brief Split a comma-separated list.
+ */
+vector<string> splitList(const string& text) {
+    vector<string> items;
+    stringstream stream(text);
+    string item;
+    while (getline(stream, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+/**
+ * @brief Next value of a splitmix64 generator, the content of the datasets.
+ */
+uint64_t splitMix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief Generate a dataset, unless a file of its size is already there: the content only depends on the size.
+ *
+ * @return false if the file cannot be written.
+ */
+bool generateDataset(const string& path, uint64_t size) {
+    struct stat file_stat;
+    if (stat(path.c_str(), &file_stat) == 0 && static_cast<uint64_t>(file_stat.st_size) == size) return true;
+
+    cerr << "generating " << path << endl;
+    ofstream file(path, ios::binary | ios::trunc);
+    vector<uint64_t> chunk(io_chunk_size / 8);
+    uint64_t state = size;
+    for (uint64_t written = 0; written < size && file; written += io_chunk_size) {
+        for (uint64_t& value : chunk) value = splitMix64(state);
+        file.write(reinterpret_cast<const char*>(chunk.data()), std::min<uint64_t>(io_chunk_size, size - written));
+    }
+    return static_cast<bool>(file);
+}
+
+/**
+ * @brief Check if two files have the same content.
+ */
+bool sameContent(const string& path1, const string& path2) {
+    ifstream file1(path1, ios::binary), file2(path2, ios::binary);
+    vector<char> chunk1(io_chunk_size), chunk2(io_chunk_size);
+    while (file1 && file2) {
+        file1.read(chunk1.data(), io_chunk_size);
+        file2.read(chunk2.data(), io_chunk_size);
+        if (file1.gcount() != file2.gcount() || memcmp(chunk1.data(), chunk2.data(), file1.gcount()) != 0) return false;
+    }
+    return file1.eof() && file2.eof();
+}
+
+/**
+ * @brief Read a file once so that it is in the page cache.
+ */
+void warmFile(const string& path) {
+    ifstream file(path, ios::binary);
+    vector<char> chunk(io_chunk_size);
+    while (file.read(chunk.data(), io_chunk_size) || file.gcount() > 0) {
+    }
+}
+
+/**
+ * @brief Evict the page cache: every clean page if permitted, else the pages of a file.
+ *
+ * @return How the cache was dropped, "drop_caches" or "fadvise".
+ */
+const char* dropCache(const string& path) {
+    sync();
+    int drop = open("/proc/sys/vm/drop_caches", O_WRONLY);
+    if (drop >= 0) {
+        bool dropped = write(drop, "3", 1) == 1;
+        close(drop);
+        if (dropped) return "drop_caches";
+    }
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+    return "fadvise";
+}
+
+/**
+ * @brief Run the command line tool with --stats and wait for it.
+ */
+RunResult runTool(const vector<string>& args) {
+    RunResult result{false, 0, 0, 0, 0, 0, 0, ""};
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0) {
+        result.error = strerror(errno);
+        return result;
+    }
+
+    auto start = chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        // the child: standard error to the pipe, standard output discarded
+        dup2(pipe_fds[1], STDERR_FILENO);
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd >= 0) dup2(null_fd, STDOUT_FILENO);
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+
+        vector<char*> argv;
+        argv.push_back(const_cast<char*>(cli_path.c_str()));
+        for (const string& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+        argv.push_back(nullptr);
+        execv(cli_path.c_str(), argv.data());
+        fprintf(stderr, "cannot run %s: %s\n", cli_path.c_str(), strerror(errno));
+        _exit(127);
+    }
+    close(pipe_fds[1]);
+    if (pid < 0) {
+        close(pipe_fds[0]);
+        result.error = strerror(errno);
+        return result;
+    }
+
+    string output;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(pipe_fds[0], buffer, sizeof(buffer))) > 0) output.append(buffer, n);
+    close(pipe_fds[0]);
+
+    int status = 0;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    result.wall_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    result.user_seconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+    result.system_seconds = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+    result.peak_rss_kb = usage.ru_maxrss;
+
+    // "... <bytes> bytes in <seconds> s, <MB/s> MB/s (cipher <seconds> s)"
+    size_t in = output.find(" bytes in ");
+    size_t cipher = output.find("(cipher ");
+    result.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0 && in != string::npos && cipher != string::npos;
+    if (result.ok) {
+        result.tool_seconds = atof(output.c_str() + in + 10);
+        result.cipher_seconds = atof(output.c_str() + cipher + 8);
+    } else {
+        // without the colors of the tool
+        for (char& c : output) {
+            if (c == '\033' || c == '\n') c = ' ';
+        }
+        result.error = output;
+    }
+    return result;
+}
+
+/**
+ * @brief Escape a string for JSON.
+ */
+string jsonString(const string& value) {
+    string escaped = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20) escaped += c;
+    }
+    return escaped + "\"";
+}
+
+/**
+ * @brief Print a run as a JSON object.
+ *
+ * @param eviction How the page cache was dropped before a cold run, nullptr for a warm run.
+ */
+void printRun(bool first, const string& operation, uint64_t size, const string& io_path, unsigned threads,
+              const char* eviction, const RunResult& run) {
+    cout << (first ? "\n" : ",\n") << "    {\"operation\": \"" << operation << "\", \"size\": " << size
+         << ", \"io_path\": \"" << io_path << "\", \"threads\": " << threads << ", \"cache\": \""
+         << (eviction ? "cold" : "warm") << "\"";
+    if (eviction) cout << ", \"eviction\": \"" << eviction << "\"";
+    if (!run.ok) {
+        cout << ", \"error\": " << jsonString(run.error) << "}";
+        return;
+    }
+    char line[512];
+    snprintf(line, sizeof(line),
+             ", \"wall_seconds\": %.6f, \"mb_per_second\": %.2f, \"tool_seconds\": %.6f, \"cipher_seconds\": %.6f, "
+             "\"other_seconds\": %.6f, \"user_seconds\": %.3f, \"system_seconds\": %.3f, \"peak_rss_mb\": %.1f}",
+             run.wall_seconds, size / run.wall_seconds / 1e6, run.tool_seconds, run.cipher_seconds,
+             std::max(0.0, run.tool_seconds - run.cipher_seconds), run.user_seconds, run.system_seconds,
+             run.peak_rss_kb / 1024.0);
+    cout << line;
+}
+
+/**
+ * @brief Parse the options.
+ *
+ * @return false if an option is unknown or invalid.
+ */
+bool parseOptions(int argc, char* argv[]) {
+    string sizes = "4K,64K,1M,16M,256M,1G";
+    unsigned hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+    string threads = hardware_threads > 1 ? "1," + to_string(hardware_threads) : "1";
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+        string name = arg.substr(0, eq), value = eq == string::npos ? "" : arg.substr(eq + 1);
+        if (value.empty()) return false;
+        if (name == "--cli") cli_path = value;
+        else if (name == "--dir") data_dir = value;
+        else if (name == "--sizes") sizes = value;
+        else if (name == "--threads") threads = value;
+        else if (name == "--paths") io_paths = splitList(value);
+        else if (name == "--cache" && (value == "warm" || value == "cold" || value == "both")) {
+            run_warm = value != "cold";
+            run_cold = value != "warm";
+        } else {
+            return false;
+        }
+    }
+
+    for (const string& item : splitList(sizes)) {
+        uint64_t size;
+        if (!parseSize(item, size)) return false;
+        dataset_sizes.push_back(size);
+    }
+    for (const string& item : splitList(threads)) {
+        if (item.find_first_not_of("0123456789") != string::npos || stoul(item) == 0) return false;
+        thread_counts.push_back(stoul(item));
+    }
+    for (const string& path : io_paths) {
+        if (path != "read" && path != "stream" && path != "mmap" && path != "io-uring") return false;
+    }
+    return !dataset_sizes.empty() && !thread_counts.empty() && !io_paths.empty();
+}
+
+int main(int argc, char* argv[]) {
+    if (!parseOptions(argc, argv)) {
+        cerr << "\033[31mUsage: bench_files [--cli=<path>] [--dir=<dataset directory>] [--sizes=<size>[K|M|G],...]\n"
+                "                   [--threads=<n>,...] [--paths=read,stream,mmap,io-uring] [--cache=warm|cold|both]\033[0m"
+             << endl;
+        return 1;
+    }
+
+    mkdir(data_dir.c_str(), 0755);
+    string key_path = data_dir + "/key.bin";
+    ofstream(key_path, ios::binary).write(reinterpret_cast<const char*>(bench_key), sizeof(bench_key));
+
+    cout << "{\n  \"cli\": " << jsonString(cli_path) << ",\n  \"runs\": [";
+    bool first = true;
+    for (uint64_t size : dataset_sizes) {
+        string plain_path = data_dir + "/data_" + sizeName(size) + ".bin";
+        string cipher_path = plain_path + ".enc", decrypted_path = plain_path + ".dec";
+        if (!generateDataset(plain_path, size)) {
+            cerr << "\033[31mError: cannot write " << plain_path << "\033[0m" << endl;
+            return 1;
+        }
+
+        for (const string& io_path : io_paths) {
+            for (unsigned threads : thread_counts) {
+                for (int cold = 0; cold < 2; cold++) {
+                    if (cold ? !run_cold : !run_warm) continue;
+
+                    // encrypt, then decrypt what was encrypted and check it against the dataset
+                    vector<string> options = {"--threads", to_string(threads), "--stats"};
+                    if (io_path != "read") options.push_back("--" + io_path);
+                    for (int decrypt = 0; decrypt < 2; decrypt++) {
+                        const string& input = decrypt ? cipher_path : plain_path;
+                        const char* eviction = nullptr;
+                        if (cold) eviction = dropCache(input);
+                        else warmFile(input);
+
+                        vector<string> args = {decrypt ? "decrypt" : "encrypt", input, key_path,
+                                               decrypt ? decrypted_path : cipher_path};
+                        args.insert(args.end(), options.begin(), options.end());
+                        RunResult run = runTool(args);
+                        if (run.ok && decrypt && !sameContent(plain_path, decrypted_path)) {
+                            run.ok = false;
+                            run.error = "the decrypted file differs from the dataset";
+                        }
+
+                        cerr << args[0] << " " << sizeName(size) << " " << io_path << " " << threads << " threads "
+                             << (cold ? "cold" : "warm") << ": "
+                             << (run.ok ? to_string(size / run.wall_seconds / 1e6) + " MB/s" : "failed") << endl;
+                        printRun(first, args[0], size, io_path, threads, eviction, run);
+                        first = false;
+
+                        // the decryption needs the encrypted file
+                        if (!run.ok) break;
+                    }
+                }
+            }
+        }
+        remove(cipher_path.c_str());
+        remove(decrypted_path.c_str());
+    }
+    cout << "\n  ]\n}" << endl;
+    return 0;
+}
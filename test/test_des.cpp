@@ -0,0 +1,795 @@
+// test_des.cpp
+//
+// Known-answer and regression checks of the DES engine, one per table, kernel and mode, against the
+// generic permute() and SBox() or published vectors. test_kernels.cpp runs the randomized differential
+// harness on top of them.
+//
+//   g++ -O2 -std=c++17 -pthread test/test_des.cpp -o test_des && ./test_des
+
+#include <stdint.h>
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// DES engine, and the key search kernels built on it
+#include "../DES/des.cpp"
+#include "../DES/search.cpp"
+
+// FIPS 46 worked example: key, plaintext and ciphertext
+const uint64_t example_key = 0x133457799BBCDFF1;
+const uint64_t example_plaintext = 0x0123456789ABCDEF;
+const uint64_t example_ciphertext = 0x85E813540F0AB405;
+
+/**
+ * @brief Next value of a splitmix64 generator, the random inputs are the same on every run.
+ */
+uint64_t next_random(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief Test the lookup tables of a permutation against the generic permute(), on every single bit and on
+ * random inputs.
+ */
+void test_permutation_lut(const std::string& name, const PermutationLUT& lut, const int* table, int table_size,
+                          int total_bits) {
+    std::cout << "Testing: " << name << " lookup tables" << std::endl;
+    uint64_t input_mask = total_bits == 64 ? ~0ULL : (1ULL << total_bits) - 1;
+    for (int bit = 0; bit < total_bits; bit++) {
+        uint64_t input = 1ULL << bit;
+        assert(permute(input, lut) == permute(input, table, table_size, total_bits));
+    }
+    uint64_t state = table_size;
+    for (int i = 0; i < 10000; i++) {
+        uint64_t input = next_random(state) & input_mask;
+        assert(permute(input, lut) == permute(input, table, table_size, total_bits));
+    }
+    std::cout << "Passed: " << name << std::endl << std::endl;
+}
+
+/**
+ * @brief Test the permutation compiled from a table against the generic permute(), with the selected program and
+ * with each program it could pick.
+ */
+template <const auto& Table, int TotalBits>
+void test_static_permutation(const std::string& name) {
+    using Perm = StaticPermutation<Table, TotalBits>;
+    std::cout << "Testing: " << name << " compiled permutation" << std::endl;
+    uint64_t input_mask = TotalBits == 64 ? ~0ULL : (1ULL << TotalBits) - 1;
+    uint64_t state = Perm::table_size + TotalBits;
+    for (int i = 0; i < 10000 + TotalBits; i++) {
+        uint64_t input = (i < TotalBits) ? 1ULL << i : next_random(state) & input_mask;
+        uint64_t expected = permute(input, Table, Perm::table_size, TotalBits);
+        assert((permute<Table, TotalBits>(input) == expected));
+        assert(permuteRotations<Perm::program>(input, std::make_index_sequence<Perm::program.rot_count>()) ==
+               expected);
+        if constexpr (Perm::program.injective) {
+            assert(permuteDeltaSwaps<Perm::program>(input, std::make_index_sequence<Perm::program.swap_count>()) ==
+                   expected);
+        }
+#if defined(__BMI2__)
+        assert(permuteChains<Perm::program>(input, std::make_index_sequence<Perm::program.chain_count>()) ==
+               expected);
+#endif
+    }
+    std::cout << "Passed: " << name << std::endl << std::endl;
+}
+
+/**
+ * @brief Regression test of the expansion of the round function, which used to shift the right half out of
+ * the 32 bits E reads and always returned 0.
+ */
+void test_expansion() {
+    std::cout << "Testing: Expansion Permutation (E) in the round function" << std::endl;
+
+    // DES bit 1 of R goes to bits 2 and 48 of E(R), DES bit 32 to bits 1 and 47
+    assert(permute(0x80000000, E_lut) == 0x400000000001ULL);
+    assert(permute(0x00000001, E_lut) == 0x800000000002ULL);
+    for (int bit = 0; bit < 32; bit++) {
+        int copies = 0;
+        for (int i = 0; i < 48; i++) copies += (E_t[i] == 32 - bit);
+        assert(__builtin_popcountll(permute(1ULL << bit, E_lut)) == copies);
+    }
+
+    // the round output depends on R, and the FIPS 46 example goes through
+    assert(DES_round(0, 0) != DES_round(0xF0AAF0AA, 0));
+    assert(DES_round(0xF0AAF0AA, 0x1B02EFFC7072) == (permute(SBox(0x6117BA866527), P, 32, 32)));
+    KeySchedule schedule;
+    buildKeySchedule(schedule, example_key);
+    assert(DES<DES_ENCRYPT>(example_plaintext, schedule) == example_ciphertext);
+    std::cout << "Passed: E(R) keeps every bit of R" << std::endl << std::endl;
+}
+
+/**
+ * @brief Test both directions of DES() on the key schedule: the reverse subkeys and the decryption of the
+ * FIPS 46 example and of random blocks under random keys.
+ */
+void test_directions() {
+    std::cout << "Testing: DES encryption and decryption (forward and reverse subkeys)" << std::endl;
+
+    // first and last subkeys of the FIPS 46 example
+    KeySchedule schedule;
+    buildKeySchedule(schedule, example_key);
+    assert(schedule.forward[0] == 0x1B02EFFC7072ULL && schedule.forward[15] == 0xCB3D8B0E17F5ULL);
+    for (int i = 0; i < 16; i++) {
+        assert(schedule.reverse[i] == schedule.forward[15 - i]);
+    }
+    assert(DES<DES_ENCRYPT>(example_plaintext, schedule) == example_ciphertext);
+    assert(DES<DES_DECRYPT>(example_ciphertext, schedule) == example_plaintext);
+
+    uint64_t state = 6;
+    for (int i = 0; i < 1000; i++) {
+        buildKeySchedule(schedule, next_random(state));
+        uint64_t block = next_random(state);
+        uint64_t encrypted = DES<DES_ENCRYPT>(block, schedule);
+        assert(encrypted == DES(block, schedule.forward));
+        assert(DES<DES_DECRYPT>(encrypted, schedule) == block);
+    }
+    std::cout << "Passed: DES in both directions" << std::endl << std::endl;
+}
+
+/**
+ * @brief Test the fused SP tables against the S-boxes followed by the generic P permutation.
+ */
+void test_sp_tables() {
+    std::cout << "Testing: fused S-box and P tables (SP)" << std::endl;
+
+    // every entry of every S-box, the other inputs set to 0
+    for (int n = 0; n < 8; n++) {
+        for (uint64_t x = 0; x < 64; x++) {
+            uint64_t input = x << (42 - 6 * n);
+            assert(SPBox(input) == permute(SBox(input), P, 32, 32));
+        }
+    }
+    uint64_t state = 2;
+    for (int i = 0; i < 100000; i++) {
+        uint64_t input = next_random(state) & 0xFFFFFFFFFFFFULL;
+        assert(SPBox(input) == permute(SBox(input), P, 32, 32));
+    }
+
+    // round 1 of the FIPS 46 example: S-box output 5C82B597, P gives 234AA9BB
+    assert(SBox(0x6117BA866527) == 0x5C82B597);
+    assert(SPBox(0x6117BA866527) == 0x234AA9BB);
+    std::cout << "Passed: SP tables" << std::endl << std::endl;
+}
+
+/**
+ * @brief Fill count blocks as stored in the files: the FIPS 46 example plaintext first, then random blocks.
+ *
+ * @param values The blocks as values, to compare with DES().
+ * @param blocks The same blocks in file order (big-endian).
+ */
+void make_blocks(uint64_t* values, uint64_t* blocks, size_t count, uint64_t seed) {
+    for (size_t i = 0; i < count; i++) {
+        values[i] = (i == 0) ? example_plaintext : next_random(seed);
+        storeBlock(blocks + i, values[i]);
+    }
+}
+
+/**
+ * @brief Test the portable 64-block bitsliced kernel against DES(), in both directions.
+ */
+void test_bitslice() {
+    std::cout << "Testing: portable bitsliced kernel (64 blocks)" << std::endl;
+
+    // the transposition is its own inverse
+    uint64_t rows[64], copy[64], state = 3;
+    for (uint64_t& row : rows) row = next_random(state);
+    memcpy(copy, rows, sizeof(rows));
+    transpose64(rows);
+    assert(rows[0] >> 63 == copy[0] >> 63 && (rows[1] >> 63) == ((copy[0] >> 62) & 0x01));
+    transpose64(rows);
+    assert(memcmp(rows, copy, sizeof(rows)) == 0);
+
+    KeySchedule schedule;
+    buildKeySchedule(schedule, example_key);
+    BitsliceKeys encryption, decryption;
+    buildBitsliceKeys(encryption, schedule.forward);
+    buildBitsliceKeys(decryption, schedule.reverse);
+
+    uint64_t values[64], blocks[64];
+    make_blocks(values, blocks, 64, 4);
+    DES_bitslice64(blocks, encryption);
+    assert(loadBlock(blocks) == example_ciphertext);
+    for (int i = 0; i < 64; i++) {
+        assert(loadBlock(blocks + i) == DES<DES_ENCRYPT>(values[i], schedule));
+    }
+    DES_bitslice64(blocks, decryption);
+    for (int i = 0; i < 64; i++) {
+        assert(loadBlock(blocks + i) == values[i]);
+    }
+    std::cout << "Passed: portable bitsliced kernel" << std::endl << std::endl;
+}
+
+/**
+ * @brief Test every bitsliced kernel the host supports against DES(), with the key schedule masks and with one key
+ * per block.
+ */
+void test_bitslice_kernels() {
+    KeySchedule schedule;
+    buildKeySchedule(schedule, example_key);
+    BitsliceKeys encryption;
+    buildBitsliceKeys(encryption, schedule.forward);
+
+    for (const BitsliceKernel& kernel : bitslice_kernels) {
+        std::cout << "Testing: " << kernel.name << " bitsliced kernel (" << kernel.blocks << " blocks)" << std::endl;
+        if (!bitsliceKernelSupported(kernel)) {
+            std::cout << "Skipped: the host does not support " << kernel.name << std::endl << std::endl;
+            continue;
+        }
+
+        alignas(64) uint64_t values[512], blocks[512], keys[512];
+        make_blocks(values, blocks, kernel.blocks, kernel.blocks);
+        kernel.run(blocks, encryption);
+        for (size_t i = 0; i < kernel.blocks; i++) {
+            assert(loadBlock(blocks + i) == DES<DES_ENCRYPT>(values[i], schedule));
+        }
+
+        // one key per block: the example key first, then random keys
+        uint64_t state = kernel.blocks + 1;
+        for (size_t i = 0; i < kernel.blocks; i++) {
+            keys[i] = (i == 0) ? example_key : next_random(state);
+        }
+        make_blocks(values, blocks, kernel.blocks, kernel.blocks);
+        kernel.run_keys(blocks, keys, false);
+        assert(loadBlock(blocks) == example_ciphertext);
+        for (size_t i = 0; i < kernel.blocks; i++) {
+            KeySchedule block_schedule;
+            buildKeySchedule(block_schedule, keys[i]);
+            assert(loadBlock(blocks + i) == DES<DES_ENCRYPT>(values[i], block_schedule));
+        }
+        kernel.run_keys(blocks, keys, true);
+        for (size_t i = 0; i < kernel.blocks; i++) {
+            assert(loadBlock(blocks + i) == values[i]);
+        }
+        std::cout << "Passed: " << kernel.name << " bitsliced kernel" << std::endl << std::endl;
+    }
+}
+
+/**
+ * @brief Test the interleaved scalar kernel of N blocks against N calls to DES(), for DES and triple DES.
+ */
+template <int N>
+void test_interleaved() {
+    std::cout << "Testing: interleaved scalar kernel (" << N << " blocks)" << std::endl;
+    uint64_t keys[48], state = 7 + N;
+    for (uint64_t& subkey : keys) subkey = next_random(state) & 0xFFFFFFFFFFFFULL;
+
+    for (int stages = 1; stages <= 3; stages += 2) {
+        for (int i = 0; i < 100; i++) {
+            uint64_t values[N], blocks[N];
+            make_blocks(values, blocks, N, state + i);
+            DES_interleaved<N>(blocks, keys, stages);
+            for (int b = 0; b < N; b++) {
+                assert(loadBlock(blocks + b) == DES(values[b], keys, stages));
+            }
+        }
+    }
+    std::cout << "Passed: interleaved scalar kernel" << std::endl << std::endl;
+}
+
+/**
+ * @brief Test the AVX2 gather kernel against DES() on 8 blocks, for DES and triple DES.
+ */
+void test_gather() {
+    std::cout << "Testing: AVX2 gather kernel (8 blocks)" << std::endl;
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("avx2")) {
+        std::cout << "Skipped: the host does not support avx2" << std::endl << std::endl;
+        return;
+    }
+
+    uint64_t keys[48], state = 8;
+    for (uint64_t& subkey : keys) subkey = next_random(state) & 0xFFFFFFFFFFFFULL;
+    KeySchedule schedule;
+    buildKeySchedule(schedule, example_key);
+
+    for (int stages = 1; stages <= 3; stages += 2) {
+        GatherKeys gather_keys;
+        buildGatherKeys(gather_keys, stages == 1 ? schedule.forward : keys, stages);
+        for (int i = 0; i < 100; i++) {
+            uint64_t values[8], blocks[8];
+            make_blocks(values, blocks, 8, state + i);
+            DES_gather8(blocks, gather_keys);
+            for (int b = 0; b < 8; b++) {
+                uint64_t expected = (stages == 1) ? DES<DES_ENCRYPT>(values[b], schedule) : DES(values[b], keys, 3);
+                assert(loadBlock(blocks + b) == expected);
+            }
+        }
+    }
+    std::cout << "Passed: AVX2 gather kernel" << std::endl << std::endl;
+}
+
+/**
+ * @brief Test processBlocks() on blocks in file order against DES(), for every block count up to two batches of the
+ * widest kernel, with every kernel the host supports.
+ */
+void test_process_blocks() {
+    KeySchedule schedule;
+    buildKeySchedule(schedule, example_key);
+    static uint64_t values[1100], blocks[1100];
+
+    for (const BitsliceKernel& kernel : bitslice_kernels) {
+        std::cout << "Testing: processBlocks() with the " << kernel.name << " kernel" << std::endl;
+        if (!bitsliceKernelSupported(kernel)) {
+            std::cout << "Skipped: the host does not support " << kernel.name << std::endl << std::endl;
+            continue;
+        }
+        KernelKeys encryption, decryption;
+        prepareKernelKeys(encryption, &kernel, schedule.forward);
+        prepareKernelKeys(decryption, &kernel, schedule.reverse);
+
+        for (size_t count = 0; count <= 1100; count += (count < 600) ? 1 : 37) {
+            make_blocks(values, blocks, count, count);
+            processBlocks(blocks, count, encryption);
+            for (size_t i = 0; i < count; i++) {
+                assert(loadBlock(blocks + i) == DES<DES_ENCRYPT>(values[i], schedule));
+            }
+            processBlocks(blocks, count, decryption);
+            for (size_t i = 0; i < count; i++) {
+                assert(loadBlock(blocks + i) == values[i]);
+            }
+        }
+        std::cout << "Passed: processBlocks() with the " << kernel.name << " kernel" << std::endl << std::endl;
+    }
+}
+
+/**
+ * @brief Test the CTR mode against the keystream DES(counter + i), with a partial last block, a counter wrapping
+ * around and ranges processed independently.
+ */
+void test_ctr() {
+    std::cout << "Testing: CTR mode" << std::endl;
+    KeySchedule schedule;
+    buildKeySchedule(schedule, example_key);
+    KernelKeys encryption;
+    prepareKernelKeys(encryption, selectBitsliceKernel("auto"), schedule.forward);
+
+    const size_t size = 8 * 1100 + 5;
+    const uint64_t counter = 0xFFFFFFFFFFFFFE00ULL;
+    static unsigned char input[size], output[size], split[size];
+    uint64_t state = 9;
+    for (unsigned char& byte : input) byte = (unsigned char)next_random(state);
+
+    ctrBlocks(reinterpret_cast<const uint64_t*>(input), reinterpret_cast<uint64_t*>(output), size, counter,
+              encryption);
+    for (size_t j = 0; j < size; j++) {
+        uint64_t keystream = DES<DES_ENCRYPT>(counter + j / 8, schedule);
+        assert(output[j] == (input[j] ^ (unsigned char)(keystream >> (56 - 8 * (j % 8)))));
+    }
+
+    // a range starting at block k uses the counter plus k, in place
+    for (size_t k : {1, 7, 512, 1099}) {
+        memcpy(split, input, size);
+        ctrBlocks(reinterpret_cast<const uint64_t*>(split), reinterpret_cast<uint64_t*>(split), 8 * k, counter,
+                  encryption);
+        ctrBlocks(reinterpret_cast<const uint64_t*>(split + 8 * k), reinterpret_cast<uint64_t*>(split + 8 * k),
+                  size - 8 * k, counter + k, encryption);
+        assert(memcmp(split, output, size) == 0);
+    }
+
+    // the same keystream decrypts
+    ctrBlocks(reinterpret_cast<const uint64_t*>(output), reinterpret_cast<uint64_t*>(output), size, counter,
+              encryption);
+    assert(memcmp(output, input, size) == 0);
+    std::cout << "Passed: CTR mode" << std::endl << std::endl;
+}
+
+/**
+ * @brief Encrypt blocks in CBC mode with DES(), one at a time.
+ */
+void cbc_reference(const uint64_t* values, uint64_t* expected, size_t count, uint64_t iv, const KeySchedule& schedule) {
+    uint64_t chain = iv;
+    for (size_t i = 0; i < count; i++) {
+        chain = expected[i] = DES<DES_ENCRYPT>(values[i] ^ chain, schedule);
+    }
+}
+
+/**
+ * @brief Test the CBC mode: the FIPS 81 example, several streams encrypted together against each stream alone,
+ * and the decryption of ranges starting anywhere.
+ */
+void test_cbc() {
+    std::cout << "Testing: CBC mode" << std::endl;
+    KeySchedule schedule;
+    buildKeySchedule(schedule, 0x0123456789ABCDEFULL);
+    KernelKeys encryption, decryption;
+    prepareKernelKeys(encryption, selectBitsliceKernel("auto"), schedule.forward);
+    prepareKernelKeys(decryption, selectBitsliceKernel("auto"), schedule.reverse);
+
+    // FIPS 81 example: "Now is the time for all "
+    const uint64_t fips_iv = 0x1234567890ABCDEFULL;
+    const uint64_t fips_plaintext[3] = {0x4E6F772069732074ULL, 0x68652074696D6520ULL, 0x666F7220616C6C20ULL};
+    const uint64_t fips_ciphertext[3] = {0xE5C7CDDE872BF27CULL, 0x43E934008C389C0FULL, 0x683788499A7C05F6ULL};
+    uint64_t blocks[3];
+    CbcStream stream = {blocks, 3, 0};
+    storeBlock(&stream.chain, fips_iv);
+    for (int i = 0; i < 3; i++) storeBlock(blocks + i, fips_plaintext[i]);
+    cbcEncryptStreams(&stream, 1, encryption);
+    for (int i = 0; i < 3; i++) assert(loadBlock(blocks + i) == fips_ciphertext[i]);
+    assert(stream.chain == blocks[2]);
+
+    // streams of different lengths, some of them empty, more than one group of ctr_tile_blocks
+    const size_t num_streams = ctr_tile_blocks + 40;
+    static uint64_t values[num_streams][40], data[num_streams][40], expected[40];
+    static CbcStream streams[num_streams];
+    uint64_t state = 10;
+    for (size_t s = 0; s < num_streams; s++) {
+        streams[s] = {data[s], s % 41 == 40 ? 0 : (s * 7) % 40 + 1, 0};
+        make_blocks(values[s], data[s], streams[s].count, s);
+        storeBlock(&streams[s].chain, next_random(state));
+    }
+    state = 10;
+    cbcEncryptStreams(streams, num_streams, encryption);
+    for (size_t s = 0; s < num_streams; s++) {
+        uint64_t iv = next_random(state);
+        cbc_reference(values[s], expected, streams[s].count, iv, schedule);
+        for (size_t i = 0; i < streams[s].count; i++) {
+            assert(loadBlock(data[s] + i) == expected[i]);
+        }
+        uint64_t last = streams[s].count == 0 ? iv : expected[streams[s].count - 1];
+        assert(loadBlock(&streams[s].chain) == last);
+    }
+
+    // decryption of a range only needs the ciphertext block before it
+    const size_t count = 1100;
+    static uint64_t plain[count], cipher[count], range[count];
+    make_blocks(plain, cipher, count, 11);
+    CbcStream long_stream = {cipher, count, 0};
+    storeBlock(&long_stream.chain, fips_iv);
+    cbcEncryptStreams(&long_stream, 1, encryption);
+    for (size_t k : {0, 1, 513, 1099}) {
+        memcpy(range, cipher, sizeof(cipher));
+        uint64_t chain;
+        storeBlock(&chain, fips_iv);
+        cbcDecryptBlocks(range, k, chain, decryption);
+        cbcDecryptBlocks(range + k, count - k, k == 0 ? chain : cipher[k - 1], decryption);
+        for (size_t i = 0; i < count; i++) {
+            assert(loadBlock(range + i) == plain[i]);
+        }
+    }
+    std::cout << "Passed: CBC mode" << std::endl << std::endl;
+}
+
+/**
+ * @brief Test triple DES with every kernel the host supports: the SP 800-67 example, E(K1) D(K2) E(K3) with
+ * single DES calls, and K1 = K2 = K3 that reduces to DES.
+ */
+void test_triple_des() {
+    // SP 800-67 example: "The quic" "k brown " "fox jump"
+    const uint64_t sp_keys[3] = {0x0123456789ABCDEFULL, 0x23456789ABCDEF01ULL, 0x456789ABCDEF0123ULL};
+    const uint64_t sp_plaintext[3] = {0x5468652071756663ULL, 0x6B2062726F776E20ULL, 0x666F78206A756D70ULL};
+    const uint64_t sp_ciphertext[3] = {0xA826FD8CE53B855FULL, 0xCCE21C8112256FE6ULL, 0x68D5C05DD9B6B900ULL};
+    DesKey sp_key(sp_keys[0], sp_keys[1], sp_keys[2]);
+    assert(sp_key.stages() == 3);
+
+    uint64_t random_keys[3], state = 12;
+    KeySchedule schedules[3];
+    for (int k = 0; k < 3; k++) {
+        random_keys[k] = next_random(state);
+        buildKeySchedule(schedules[k], random_keys[k]);
+    }
+    DesKey random_key(random_keys[0], random_keys[1], random_keys[2]);
+    DesKey repeated_key(example_key, example_key, example_key);
+
+    KeySchedule schedule;
+    buildKeySchedule(schedule, example_key);
+    const size_t count = 1100;
+    static uint64_t values[count], blocks[count], output[count];
+    make_blocks(values, blocks, count, 13);
+
+    for (const BitsliceKernel& kernel : bitslice_kernels) {
+        std::cout << "Testing: triple DES with the " << kernel.name << " kernel" << std::endl;
+        if (!bitsliceKernelSupported(kernel)) {
+            std::cout << "Skipped: the host does not support " << kernel.name << std::endl << std::endl;
+            continue;
+        }
+
+        DesContext sp_context(sp_key, kernel.name);
+        assert(strcmp(sp_context.kernel(), kernel.name) == 0);
+        sp_context.encrypt_blocks(sp_plaintext, output, 3);
+        for (int i = 0; i < 3; i++) assert(output[i] == sp_ciphertext[i]);
+        sp_context.decrypt_blocks(sp_ciphertext, output, 3);
+        for (int i = 0; i < 3; i++) assert(output[i] == sp_plaintext[i]);
+
+        DesContext random_context(random_key, kernel.name);
+        random_context.encrypt_blocks(values, output, count);
+        for (size_t i = 0; i < count; i++) {
+            uint64_t expected = DES<DES_ENCRYPT>(values[i], schedules[0]);
+            expected = DES<DES_DECRYPT>(expected, schedules[1]);
+            expected = DES<DES_ENCRYPT>(expected, schedules[2]);
+            assert(output[i] == expected);
+        }
+        random_context.decrypt_blocks(output, output, count);
+        assert(memcmp(output, values, sizeof(values)) == 0);
+
+        DesContext repeated_context(repeated_key, kernel.name);
+        repeated_context.encrypt_blocks(values, output, count);
+        for (size_t i = 0; i < count; i++) {
+            assert(output[i] == DES<DES_ENCRYPT>(values[i], schedule));
+        }
+        std::cout << "Passed: triple DES with the " << kernel.name << " kernel" << std::endl << std::endl;
+    }
+}
+
+/**
+ * @brief Test the byte operations of DesContext on aligned, unaligned and shared buffers against encrypt_blocks(), and
+ * the multi-stream CBC encryption against one stream at a time.
+ */
+void test_context_bytes() {
+    std::cout << "Testing: DesContext byte operations and CBC streams" << std::endl;
+    DesContext context{DesKey(example_key)};
+    const size_t count = 1100, size = 8 * count;
+    static uint64_t values[count], expected_values[count];
+    static uint8_t input[size + 1], output[size + 1], expected[size];
+    make_blocks(values, reinterpret_cast<uint64_t*>(input), count, 14);
+    context.encrypt_blocks(values, expected_values, count);
+    memcpy(expected, input, size);
+    for (size_t i = 0; i < count; i++) storeBlock(reinterpret_cast<uint64_t*>(expected) + i, expected_values[i]);
+
+    // aligned, unaligned output, then in place; decrypting restores the input
+    assert(context.encrypt_bytes(input, output, size) && memcmp(output, expected, size) == 0);
+    assert(context.encrypt_bytes(input, output + 1, size) && memcmp(output + 1, expected, size) == 0);
+    assert(context.decrypt_bytes(output + 1, output + 1, size) && memcmp(output + 1, input, size) == 0);
+    assert(!context.encrypt_bytes(input, output, size - 1));
+
+    // CBC: one chain through the byte API, unaligned and in parts, equals the chain of cbc_encrypt_streams()
+    uint64_t chain = example_plaintext, parts_chain = example_plaintext;
+    assert(context.cbc_encrypt_bytes(input, output, size, chain));
+    memcpy(expected, output, size);
+    memcpy(output + 1, input, size);
+    assert(context.cbc_encrypt_bytes(output + 1, output + 1, 8 * 513, parts_chain));
+    assert(context.cbc_encrypt_bytes(output + 1 + 8 * 513, output + 1 + 8 * 513, size - 8 * 513, parts_chain));
+    assert(memcmp(output + 1, expected, size) == 0 && parts_chain == chain);
+    parts_chain = example_plaintext;
+    assert(context.cbc_decrypt_bytes(output + 1, output + 1, size, parts_chain));
+    assert(memcmp(output + 1, input, size) == 0 && parts_chain == chain);
+
+    // streams of every length from 0 to 40 blocks, the data unaligned
+    const size_t num_streams = 41;
+    static uint8_t stream_data[num_streams][8 * 40 + 1];
+    DesCbcStream streams[num_streams];
+    for (size_t s = 0; s < num_streams; s++) {
+        memcpy(stream_data[s] + 1, input + 8 * s, 8 * s);
+        streams[s] = {stream_data[s] + 1, 8 * s, s};
+    }
+    assert(context.cbc_encrypt_streams(streams, num_streams));
+    for (size_t s = 0; s < num_streams; s++) {
+        uint64_t stream_chain = s;
+        assert(context.cbc_encrypt_bytes(input + 8 * s, output, 8 * s, stream_chain));
+        assert(memcmp(stream_data[s] + 1, output, 8 * s) == 0 && streams[s].chain == stream_chain);
+    }
+    streams[0].size = 4;
+    assert(!context.cbc_encrypt_streams(streams, num_streams));
+    std::cout << "Passed: DesContext byte operations and CBC streams" << std::endl << std::endl;
+}
+
+/**
+ * @brief Test processBlocksMultiKey() and DesMultiKey against DES() with the schedule of each block's key, for every
+ * block count up to two batches of the widest kernel, with every kernel the host supports.
+ */
+void test_multi_key() {
+    const size_t count = 1100;
+    static uint64_t keys[count], values[count], blocks[count], output[count];
+    static KeySchedule schedules[count];
+    uint64_t state = 15;
+    for (size_t i = 0; i < count; i++) {
+        keys[i] = (i == 0) ? example_key : next_random(state);
+        buildKeySchedule(schedules[i], keys[i]);
+    }
+
+    for (const BitsliceKernel& kernel : bitslice_kernels) {
+        std::cout << "Testing: multi-key ECB with the " << kernel.name << " kernel" << std::endl;
+        if (!bitsliceKernelSupported(kernel)) {
+            std::cout << "Skipped: the host does not support " << kernel.name << std::endl << std::endl;
+            continue;
+        }
+
+        for (size_t n = 0; n <= count; n += (n < 600) ? 1 : 37) {
+            make_blocks(values, blocks, n, n);
+            processBlocksMultiKey(blocks, keys, n, &kernel, DES_ENCRYPT);
+            for (size_t i = 0; i < n; i++) {
+                assert(loadBlock(blocks + i) == DES<DES_ENCRYPT>(values[i], schedules[i]));
+            }
+            processBlocksMultiKey(blocks, keys, n, &kernel, DES_DECRYPT);
+            for (size_t i = 0; i < n; i++) {
+                assert(loadBlock(blocks + i) == values[i]);
+            }
+        }
+
+        // the public API, in place, and the parity bits of the keys are ignored
+        DesMultiKey multi_key(kernel.name);
+        assert(strcmp(multi_key.kernel(), kernel.name) == 0);
+        make_blocks(values, blocks, count, 16);
+        multi_key.encrypt_blocks(keys, values, output, count);
+        assert(output[0] == example_ciphertext);
+        for (size_t i = 0; i < count; i++) {
+            assert(output[i] == DES<DES_ENCRYPT>(values[i], schedules[i]));
+        }
+        for (size_t i = 0; i < count; i++) keys[i] ^= 0x0101010101010101ULL;
+        multi_key.decrypt_blocks(keys, output, output, count);
+        for (size_t i = 0; i < count; i++) keys[i] ^= 0x0101010101010101ULL;
+        assert(memcmp(output, values, sizeof(values)) == 0);
+        std::cout << "Passed: multi-key ECB with the " << kernel.name << " kernel" << std::endl << std::endl;
+    }
+}
+
+/**
+ * @brief Test the key search kernels on the FIPS 46 example: every batch of the 2^14 keys that share its first six
+ * bytes is tried, and the example key must be the only candidate.
+ */
+void test_search() {
+    SearchSpace space;
+    buildSearchSpace(space, example_key, 0xFFFFFFFFFFFF0000ULL);
+    assert(space.num_free == 14 && space.size() == 16384);
+    SearchBlock block;
+    buildSearchBlock(block, example_plaintext, example_ciphertext);
+
+    for (const SearchKernel& search_kernel : search_kernels) {
+        std::cout << "Testing: key search with the " << search_kernel.name << " kernel" << std::endl;
+        const BitsliceKernel* kernel = selectBitsliceKernel(search_kernel.name);
+        if (kernel == nullptr) {
+            std::cout << "Skipped: the host does not support " << search_kernel.name << std::endl << std::endl;
+            continue;
+        }
+        assert(selectSearchKernel(kernel) == &search_kernel);
+
+        size_t num_candidates = 0;
+        for (uint64_t first = 0; first < space.size(); first += search_kernel.keys) {
+            SearchKeyPlanes planes;
+            planes.start(space, search_kernel.keys / 64, first);
+            uint64_t candidates[8];
+            search_kernel.run(planes, block, candidates);
+            for (size_t t = 0; t < search_kernel.keys; t++) {
+                if (((candidates[t / 64] >> (t % 64)) & 0x01) == 0) continue;
+                num_candidates++;
+                assert(searchKeyAt(space, first + t) == example_key);
+            }
+        }
+        assert(num_candidates == 1);
+        std::cout << "Passed: key search with the " << search_kernel.name << " kernel" << std::endl << std::endl;
+    }
+
+    // the candidates are verified on every pair with the scalar DES
+    KeySchedule schedule;
+    buildKeySchedule(schedule, example_key);
+    uint64_t pairs[4] = {example_plaintext, example_ciphertext, 0, DES<DES_ENCRYPT>(0, schedule)};
+    assert(verifySearchKey(example_key, pairs, 2));
+    assert(!verifySearchKey(example_key ^ 0x0200000000000000ULL, pairs, 1));
+    pairs[3] ^= 1;
+    assert(!verifySearchKey(example_key, pairs, 2));
+}
+
+/**
+ * @brief Test the Gray-code enumeration of a search space: 2^16 scalar steps of flipKeyBit() against the schedule
+ * built from each key, then the key planes stepped by next() across every batch of a 2^17-key space, against the
+ * planes of start() at each batch, with the search kernels still finding the example key.
+ */
+void test_gray_code() {
+    std::cout << "Testing: Gray-code key schedules" << std::endl;
+    SearchSpace space;
+    buildSearchSpace(space, example_key, 0xFFFF000000000000ULL);
+    KeySchedule schedule, expected;
+    buildKeySchedule(schedule, searchKeyAt(space, 0));
+    uint64_t index = 0;
+    for (uint64_t step = 1; step <= 65536; step++) {
+        int b = __builtin_ctzll(step);
+        index ^= uint64_t(1) << b;
+        flipKeyBit(schedule, space.free_bits[b]);
+        buildKeySchedule(expected, searchKeyAt(space, index));
+        assert(memcmp(&schedule, &expected, sizeof(KeySchedule)) == 0);
+    }
+    assert(index == 0x18000);
+    std::cout << "Passed: Gray-code key schedules" << std::endl << std::endl;
+
+    // the example key is in none of the first batches
+    buildSearchSpace(space, example_key, 0xFFFFFFFFFFF00000ULL);
+    assert(space.num_free == 17);
+    SearchBlock block;
+    buildSearchBlock(block, example_plaintext, example_ciphertext);
+    static SearchKeyPlanes planes, started;
+    for (const SearchKernel& search_kernel : search_kernels) {
+        std::cout << "Testing: Gray-code key planes with the " << search_kernel.name << " kernel" << std::endl;
+        if (selectBitsliceKernel(search_kernel.name) == nullptr) {
+            std::cout << "Skipped: the host does not support " << search_kernel.name << std::endl << std::endl;
+            continue;
+        }
+
+        int lanes = static_cast<int>(search_kernel.keys / 64);
+        uint64_t num_batches = space.size() / search_kernel.keys;
+        std::vector<bool> visited(num_batches);
+        size_t num_candidates = 0;
+        planes.start(space, lanes, 0);
+        for (uint64_t i = 0; i < num_batches; i++) {
+            if (i > 0) planes.next(space);
+            assert(planes.batch % search_kernel.keys == 0 && !visited[planes.batch / search_kernel.keys]);
+            visited[planes.batch / search_kernel.keys] = true;
+            started.start(space, lanes, planes.batch);
+            assert(memcmp(planes.words, started.words, 64 * lanes * sizeof(uint64_t)) == 0);
+
+            uint64_t candidates[8];
+            search_kernel.run(planes, block, candidates);
+            for (size_t t = 0; t < search_kernel.keys; t++) {
+                if (((candidates[t / 64] >> (t % 64)) & 0x01) == 0) continue;
+                num_candidates++;
+                assert(i > 0 && searchKeyAt(space, planes.batch + t) == example_key);
+            }
+        }
+        assert(num_candidates == 1);
+        std::cout << "Passed: Gray-code key planes with the " << search_kernel.name << " kernel" << std::endl
+                  << std::endl;
+    }
+}
+
+/**
+ * @brief Test the key schedule built from the contribution tables against the bit-serial reference on random keys,
+ * and against the 16 subkeys of the FIPS 46 example.
+ */
+void test_key_schedule() {
+    std::cout << "Testing: key schedule tables" << std::endl;
+    const uint64_t example_subkeys[16] = {
+        0x1B02EFFC7072ULL, 0x79AED9DBC9E5ULL, 0x55FC8A42CF99ULL, 0x72ADD6DB351DULL,
+        0x7CEC07EB53A8ULL, 0x63A53E507B2FULL, 0xEC84B7F618BCULL, 0xF78A3AC13BFBULL,
+        0xE0DBEBEDE781ULL, 0xB1F347BA464FULL, 0x215FD3DED386ULL, 0x7571F59467E9ULL,
+        0x97C5D1FABA41ULL, 0x5F43B7F2E73AULL, 0xBF918D3D3F0AULL, 0xCB3D8B0E17F5ULL};
+    KeySchedule schedule, serial_schedule;
+    buildKeySchedule(schedule, example_key);
+    for (int i = 0; i < 16; i++) {
+        assert(schedule.forward[i] == example_subkeys[i] && schedule.reverse[15 - i] == example_subkeys[i]);
+    }
+
+    // the parity bits are ignored
+    buildKeySchedule(serial_schedule, example_key ^ 0x0101010101010101ULL);
+    assert(memcmp(&schedule, &serial_schedule, sizeof(KeySchedule)) == 0);
+
+    uint64_t state = 17;
+    for (int i = 0; i < 10000; i++) {
+        uint64_t key = next_random(state);
+        buildKeySchedule(schedule, key);
+        buildKeyScheduleSerial(serial_schedule, key);
+        assert(memcmp(&schedule, &serial_schedule, sizeof(KeySchedule)) == 0);
+    }
+    std::cout << "Passed: key schedule tables" << std::endl << std::endl;
+}
+
+int main() {
+    initPermutationTables();
+
+    test_permutation_lut("Permuted Choice 1 (PC-1)", pc_1_lut, pc_1, 56, 64);
+    test_permutation_lut("Permuted Choice 2 (PC-2)", pc_2_lut, pc_2, 48, 56);
+    test_permutation_lut("Initial Permutation (IP)", IP_lut, IP_t, 64, 64);
+    test_permutation_lut("Final Permutation (FP)", P_1_lut, P_1, 64, 64);
+    test_permutation_lut("Expansion Permutation (E)", E_lut, E_t, 48, 32);
+    test_permutation_lut("Permutation (P)", P_lut, P, 32, 32);
+    test_static_permutation<pc_1, 64>("Permuted Choice 1 (PC-1)");
+    test_static_permutation<pc_2, 56>("Permuted Choice 2 (PC-2)");
+    test_static_permutation<IP_t, 64>("Initial Permutation (IP)");
+    test_static_permutation<P_1, 64>("Final Permutation (FP)");
+    test_static_permutation<E_t, 32>("Expansion Permutation (E)");
+    test_static_permutation<P, 32>("Permutation (P)");
+    test_expansion();
+    test_sp_tables();
+    test_directions();
+    test_key_schedule();
+    test_interleaved<2>();
+    test_interleaved<4>();
+    test_interleaved<8>();
+    test_gather();
+    test_bitslice();
+    test_bitslice_kernels();
+    test_process_blocks();
+    test_ctr();
+    test_cbc();
+    test_triple_des();
+    test_context_bytes();
+    test_multi_key();
+    test_search();
+    test_gray_code();
+
+    std::cout << "\033[32mAll DES tests passed successfully!\033[0m" << std::endl;
+    return 0;
+}
@@ -0,0 +1,1080 @@
+// test_kernels.cpp
+//
+// Differential verification of every fast path of the DES engine against a bit-serial reference DES, built
+// only from the generic permute(), SBox() and the tables that test_permute.cpp checks:
+//
+//   1. the known-answer vectors of FIPS 81, NIST SP 800-17 and SP 800-67, on every kernel;
+//   2. the primitives on random inputs: every permutation (LUT and compile-time), the fused SP tables, the
+//      round, the key schedules, DES(), and the kernels that take a fixed number of blocks (interleaved,
+//      gather, key search);
+//   3. random cases (kernel, mode, keys, length, chunk boundaries) through the library and the batching
+//      functions, against DES() on the bit-serial key schedule, itself checked against the reference by 2;
+//   4. with --cli, random files through every I/O path, mode and thread count of the command line tool.
+//
+// The checks run in parallel. The first mismatch (lowest case number) is minimized and printed with the
+// option that replays it.
+//
+//   g++ -O2 -std=c++17 -pthread DES/main.cpp -o des
+//   g++ -O2 -std=c++17 -pthread test/test_kernels.cpp -o test_kernels
+//   ./test_kernels [--cases=<n>] [--seed=<n>] [--threads=<n>] [--cli=./des [--cli-cases=<n>]] [--replay=<case>]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// DES engine, and the search kernels built on it
+#include "../DES/des.cpp"
+#include "../DES/search.cpp"
+
+using namespace std;
+
+// options
+uint64_t seed = 1;             // --seed
+uint64_t num_cases = 10000;    // --cases, random cases of the library, the primitives get 5 samples per case
+uint64_t num_cli_cases = 200;  // --cli-cases, random files through the command line tool
+unsigned num_threads = 0;      // --threads, 0 for the hardware concurrency
+string cli_path;               // --cli, path of the command line tool, its cases are skipped without it
+string replay;                 // --replay, a single case to run
+
+// directory of the files of the command line tool
+string work_dir;
+
+/**
+ * @brief Next value of a splitmix64 generator.
+ */
+uint64_t splitMix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief Random value below a bound.
+ */
+uint64_t randomBelow(uint64_t& state, uint64_t bound) {
+    return splitMix64(state) % bound;
+}
+
+/**
+ * @brief Format a 64-bit value as 16 hex digits.
+ */
+string hex64(uint64_t value) {
+    char text[17];
+    snprintf(text, sizeof(text), "%016llX", static_cast<unsigned long long>(value));
+    return text;
+}
+
+// Reference
+
+/**
+ * @brief The 16 subkeys of a key, bit by bit with the generic permute() (reference).
+ */
+void referenceSubkeys(uint64_t key, uint64_t subkeys[16]) {
+    uint64_t cd = permute(key, pc_1, 56, 64);
+    uint32_t c = cd >> 28, d = cd & 0x0FFFFFFF;
+    for (int i = 0; i < 16; i++) {
+        for (int s = 0; s < left_shift_table[i]; s++) {
+            c = ((c << 1) | (c >> 27)) & 0x0FFFFFFF;
+            d = ((d << 1) | (d >> 27)) & 0x0FFFFFFF;
+        }
+        subkeys[i] = permute((static_cast<uint64_t>(c) << 28) | d, pc_2, 48, 56);
+    }
+}
+
+/**
+ * @brief Round function P(S(E(r) ^ subkey)), with the generic permute() and SBox() (reference).
+ */
+uint32_t referenceRound(uint32_t r, uint64_t subkey) {
+    return permute(SBox(permute(r, E_t, 48, 32) ^ subkey), P, 32, 32);
+}
+
+/**
+ * @brief DES of a block (reference).
+ */
+uint64_t referenceDES(uint64_t block, uint64_t key, bool decrypt) {
+    uint64_t subkeys[16];
+    referenceSubkeys(key, subkeys);
+
+    uint64_t lr = permute(block, IP_t, 64, 64);
+    uint32_t l = lr >> 32, r = lr & 0xFFFFFFFF;
+    for (int i = 0; i < 16; i++) {
+        uint32_t next = l ^ referenceRound(r, subkeys[decrypt ? 15 - i : i]);
+        l = r;
+        r = next;
+    }
+    return permute((static_cast<uint64_t>(r) << 32) | l, P_1, 64, 64);
+}
+
+/**
+ * @brief Triple DES (EDE) of a block (reference).
+ */
+uint64_t referenceTripleDES(uint64_t block, const uint64_t keys[3], bool decrypt) {
+    if (decrypt) {
+        return referenceDES(referenceDES(referenceDES(block, keys[2], true), keys[1], false), keys[0], true);
+    }
+    return referenceDES(referenceDES(referenceDES(block, keys[0], false), keys[1], true), keys[2], false);
+}
+
+// Kernels
+
+// names of the bitsliced kernels this CPU runs
+vector<const char*> kernel_names;
+
+/**
+ * @brief Run a check on the threads for every index below count.
+ *
+ * @param check Returns false if the check of an index fails.
+ * @return The lowest failing index, count if every check passed.
+ */
+uint64_t runParallel(uint64_t count, const function<bool(uint64_t)>& check) {
+    atomic<uint64_t> next{0}, first_failure{count};
+    auto worker = [&] {
+        // every index below a failure is still checked, so the lowest one is found
+        for (uint64_t i = next++; i < first_failure; i = next++) {
+            if (check(i)) continue;
+            uint64_t failure = first_failure;
+            while (i < failure && !first_failure.compare_exchange_weak(failure, i)) {
+            }
+        }
+    };
+
+    vector<thread> threads;
+    for (unsigned t = 0; t < num_threads; t++) threads.emplace_back(worker);
+    for (thread& t : threads) t.join();
+    return first_failure;
+}
+
+// Known answers
+
+/**
+ * @brief A known-answer vector, DES if k2 and k3 are 0, else triple DES (EDE).
+ */
+struct KnownAnswer {
+    const char* source;
+    uint64_t keys[3];
+    uint64_t plaintext;
+    uint64_t ciphertext;
+};
+
+const KnownAnswer known_answers[] = {
+    // variable plaintext (IP and E), variable key (PC-1 and PC-2), permutation and substitution tables
+    {"SP 800-17 table 1", {0x0101010101010101, 0, 0}, 0x8000000000000000, 0x95F8A5E5DD31D900},
+    {"SP 800-17 table 1", {0x0101010101010101, 0, 0}, 0x4000000000000000, 0xDD7F121CA5015619},
+    {"SP 800-17 table 1", {0x0101010101010101, 0, 0}, 0x2000000000000000, 0x2E8653104F3834EA},
+    {"SP 800-17 table 1", {0x0101010101010101, 0, 0}, 0x1000000000000000, 0x4BD388FF6CD81D4F},
+    {"SP 800-17 table 1", {0x0101010101010101, 0, 0}, 0x0000000000000001, 0x166B40B44ABA4BD6},
+    {"SP 800-17 table 2", {0x8001010101010101, 0, 0}, 0x0000000000000000, 0x95A8D72813DAA94D},
+    {"SP 800-17 table 2", {0x4001010101010101, 0, 0}, 0x0000000000000000, 0x0EEC1487DD8C26D5},
+    {"SP 800-17 table 2", {0x0101010101010180, 0, 0}, 0x0000000000000000, 0x9CC62DF43B6EED74},
+    {"SP 800-17 table 3", {0x1046913489980131, 0, 0}, 0x0000000000000000, 0x88D55E54F54C97B4},
+    {"SP 800-17 table 4", {0x7CA110454A1A6E57, 0, 0}, 0x01A1D6D039776742, 0x690F5B0D9A26939B},
+    {"SP 800-17 table 4", {0x0131D9619DC1376E, 0, 0}, 0x5CD54CA83DEF57DA, 0x7A389D10354BD271},
+    // "Now is the time for all "
+    {"FIPS 81 ECB", {0x0123456789ABCDEF, 0, 0}, 0x4E6F772069732074, 0x3FA40E8A984D4815},
+    {"FIPS 81 ECB", {0x0123456789ABCDEF, 0, 0}, 0x68652074696D6520, 0x6A271787AB8883F9},
+    {"FIPS 81 ECB", {0x0123456789ABCDEF, 0, 0}, 0x666F7220616C6C20, 0x893D51EC4B563B53},
+    {"textbook", {0x133457799BBCDFF1, 0, 0}, 0x0123456789ABCDEF, 0x85E813540F0AB405},
+    // "The qufck brown fox jump"
+    {"SP 800-67 TDEA", {0x0123456789ABCDEF, 0x23456789ABCDEF01, 0x456789ABCDEF0123}, 0x5468652071756663,
+     0xA826FD8CE53B855F},
+    {"SP 800-67 TDEA", {0x0123456789ABCDEF, 0x23456789ABCDEF01, 0x456789ABCDEF0123}, 0x6B2062726F776E20,
+     0xCCE21C8112256FE6},
+    {"SP 800-67 TDEA", {0x0123456789ABCDEF, 0x23456789ABCDEF01, 0x456789ABCDEF0123}, 0x666F78206A756D70,
+     0x68D5C05DD9B6B900},
+};
+
+/**
+ * @brief Check the known-answer vectors on the reference, DES() and every kernel.
+ *
+ * @return false, with the failing vector printed, on a mismatch.
+ */
+bool testKnownAnswers() {
+    cout << "Testing: known-answer vectors" << endl;
+    for (const KnownAnswer& answer : known_answers) {
+        bool triple = answer.keys[1] != 0;
+        DesKey des_key = triple ? DesKey(answer.keys[0], answer.keys[1], answer.keys[2]) : DesKey(answer.keys[0]);
+        string where = string(answer.source) + ", key " + hex64(answer.keys[0]) +
+                       (triple ? " " + hex64(answer.keys[1]) + " " + hex64(answer.keys[2]) : "") + ", plaintext " +
+                       hex64(answer.plaintext);
+
+        // the reference, then DES()
+        uint64_t encrypted = triple ? referenceTripleDES(answer.plaintext, answer.keys, false)
+                                    : referenceDES(answer.plaintext, answer.keys[0], false);
+        uint64_t decrypted = triple ? referenceTripleDES(answer.ciphertext, answer.keys, true)
+                                    : referenceDES(answer.ciphertext, answer.keys[0], true);
+        uint64_t des_encrypted = DES(answer.plaintext, des_key.encryption_keys(), des_key.stages());
+        uint64_t des_decrypted = DES(answer.ciphertext, des_key.decryption_keys(), des_key.stages());
+        if (encrypted != answer.ciphertext || decrypted != answer.plaintext || des_encrypted != answer.ciphertext ||
+            des_decrypted != answer.plaintext) {
+            cerr << "\033[31mMismatch: " << where << ": expected " << hex64(answer.ciphertext) << ", reference "
+                 << hex64(encrypted) << ", DES() " << hex64(des_encrypted) << "\033[0m" << endl;
+            return false;
+        }
+
+        // every kernel, on a full batch of the widest one and its tails
+        for (const char* kernel : kernel_names) {
+            DesContext context(des_key, kernel);
+            vector<uint64_t> blocks(1031, answer.plaintext);
+            context.encrypt_blocks(blocks.data(), blocks.data(), blocks.size());
+            bool ok = all_of(blocks.begin(), blocks.end(), [&](uint64_t b) { return b == answer.ciphertext; });
+            context.decrypt_blocks(blocks.data(), blocks.data(), blocks.size());
+            ok = ok && all_of(blocks.begin(), blocks.end(), [&](uint64_t b) { return b == answer.plaintext; });
+            if (!triple) {
+                vector<uint64_t> keys(blocks.size(), answer.keys[0]);
+                DesMultiKey multi_key(kernel);
+                multi_key.encrypt_blocks(keys.data(), blocks.data(), blocks.data(), blocks.size());
+                ok = ok && all_of(blocks.begin(), blocks.end(), [&](uint64_t b) { return b == answer.ciphertext; });
+            }
+            if (!ok) {
+                cerr << "\033[31mMismatch: " << where << ": kernel " << kernel << "\033[0m" << endl;
+                return false;
+            }
+        }
+    }
+
+    // FIPS 81 CBC example, IV 1234567890ABCDEF
+    const uint8_t fips81_plaintext[] = "Now is the time for all ";
+    const uint64_t fips81_cbc[3] = {0xE5C7CDDE872BF27C, 0x43E934008C389C0F, 0x683788499A7C05F6};
+    for (const char* kernel : kernel_names) {
+        DesContext context(DesKey(0x0123456789ABCDEF), kernel);
+        uint8_t ciphertext[24];
+        uint64_t chain = 0x1234567890ABCDEF;
+        context.cbc_encrypt_bytes(fips81_plaintext, ciphertext, 24, chain);
+        for (int i = 0; i < 3; i++) {
+            if (loadBlock(reinterpret_cast<const uint64_t*>(ciphertext) + i) != fips81_cbc[i]) {
+                cerr << "\033[31mMismatch: FIPS 81 CBC, block " << i << ": kernel " << kernel << "\033[0m" << endl;
+                return false;
+            }
+        }
+    }
+
+    cout << "Passed: " << sizeof(known_answers) / sizeof(known_answers[0]) << " vectors and FIPS 81 CBC on "
+         << kernel_names.size() << " kernels" << endl << endl;
+    return true;
+}
+
+// Primitives
+
+/**
+ * @brief Check the LUT and compile-time implementations of a permutation against the generic one.
+ */
+template <const auto& Table, int TotalBits>
+bool checkPermutation(const char* name, const PermutationLUT& lut, uint64_t x, string& report) {
+    uint64_t input = TotalBits == 64 ? x : x & ((uint64_t(1) << TotalBits) - 1);
+    uint64_t expected = permute(input, Table, sizeof(Table) / sizeof(Table[0]), TotalBits);
+    uint64_t by_lut = permute(input, lut);
+    uint64_t by_program = permute<Table, TotalBits>(input);
+    if (by_lut == expected && by_program == expected) return true;
+    report = string("permute ") + name + " of " + hex64(input) + ": expected " + hex64(expected) + ", LUT " +
+             hex64(by_lut) + ", compile-time " + hex64(by_program);
+    return false;
+}
+
+/**
+ * @brief Check the primitives on the random inputs of a sample.
+ *
+ * @param index Number of the sample.
+ * @param report Filled with the inputs and the results on a mismatch.
+ * @return false on a mismatch.
+ */
+bool checkPrimitives(uint64_t index, string& report) {
+    uint64_t state = seed * 0xD1B54A32D192ED03ULL + index;
+    uint64_t x = splitMix64(state), key = splitMix64(state);
+
+    if (!checkPermutation<pc_1, 64>("PC-1", pc_1_lut, x, report) ||
+        !checkPermutation<pc_2, 56>("PC-2", pc_2_lut, x, report) ||
+        !checkPermutation<IP_t, 64>("IP", IP_lut, x, report) ||
+        !checkPermutation<P_1, 64>("FP", P_1_lut, x, report) ||
+        !checkPermutation<E_t, 32>("E", E_lut, x, report) || !checkPermutation<P, 32>("P", P_lut, x, report)) {
+        return false;
+    }
+
+    // fused S-box and P tables, and the round
+    uint64_t x48 = x & 0xFFFFFFFFFFFF;
+    uint32_t sp = SPBox(x48), expected_sp = permute(SBox(x48), P, 32, 32);
+    if (sp != expected_sp) {
+        report = "SPBox of " + hex64(x48) + ": expected " + hex64(expected_sp) + ", got " + hex64(sp);
+        return false;
+    }
+    uint32_t r = x >> 32;
+    uint64_t subkey = key & 0xFFFFFFFFFFFF;
+    if (DES_round(r, subkey) != referenceRound(r, subkey)) {
+        report = "DES_round of " + hex64(r) + " with subkey " + hex64(subkey) + ": expected " +
+                 hex64(referenceRound(r, subkey)) + ", got " + hex64(DES_round(r, subkey));
+        return false;
+    }
+
+    // key schedules: the tables, bit by bit, and a single bit flipped
+    uint64_t subkeys[16];
+    referenceSubkeys(key, subkeys);
+    KeySchedule schedule, serial_schedule;
+    buildKeySchedule(schedule, key);
+    buildKeyScheduleSerial(serial_schedule, key);
+    for (int i = 0; i < 16; i++) {
+        if (schedule.forward[i] != subkeys[i] || schedule.reverse[15 - i] != subkeys[i] ||
+            serial_schedule.forward[i] != subkeys[i] || serial_schedule.reverse[15 - i] != subkeys[i]) {
+            report = "key schedule of " + hex64(key) + ", subkey " + to_string(i + 1) + ": expected " +
+                     hex64(subkeys[i]) + ", tables " + hex64(schedule.forward[i]) + ", bit-serial " +
+                     hex64(serial_schedule.forward[i]);
+            return false;
+        }
+    }
+    int bit = randomBelow(state, 64);
+    KeySchedule flipped = schedule, expected_flipped;
+    flipKeyBit(flipped, bit);
+    buildKeySchedule(expected_flipped, key ^ (uint64_t(1) << (63 - bit)));
+    if (memcmp(&flipped, &expected_flipped, sizeof(KeySchedule)) != 0) {
+        report = "flipKeyBit of " + hex64(key) + ", bit " + to_string(bit);
+        return false;
+    }
+
+    // DES() in both directions
+    uint64_t encrypted = referenceDES(x, key, false);
+    if (DES<DES_ENCRYPT>(x, schedule) != encrypted || DES<DES_DECRYPT>(encrypted, schedule) != x) {
+        report = "DES() of " + hex64(x) + " with key " + hex64(key) + ": expected " + hex64(encrypted) + ", got " +
+                 hex64(DES<DES_ENCRYPT>(x, schedule));
+        return false;
+    }
+
+    // kernels on a fixed number of blocks, in file order
+    uint64_t blocks[8], expected[8];
+    for (int b = 0; b < 8; b++) {
+        blocks[b] = splitMix64(state);
+        storeBlock(expected + b, DES<DES_ENCRYPT>(loadBlock(blocks + b), schedule));
+    }
+    auto checkKernel = [&](const char* name, const function<void(uint64_t*)>& kernel) {
+        uint64_t output[8];
+        memcpy(output, blocks, sizeof(blocks));
+        kernel(output);
+        for (int b = 0; b < 8; b++) {
+            if (output[b] != expected[b]) {
+                report = string(name) + " with key " + hex64(key) + ", block " + to_string(b) + " " +
+                         hex64(loadBlock(blocks + b)) + ": expected " + hex64(loadBlock(expected + b)) + ", got " +
+                         hex64(loadBlock(output + b));
+                return false;
+            }
+        }
+        return true;
+    };
+    if (!checkKernel("DES_interleaved<2>", [&](uint64_t* b) { for (int i = 0; i < 8; i += 2) DES_interleaved<2>(b + i, schedule.forward); }) ||
+        !checkKernel("DES_interleaved<4>", [&](uint64_t* b) { for (int i = 0; i < 8; i += 4) DES_interleaved<4>(b + i, schedule.forward); }) ||
+        !checkKernel("DES_interleaved<8>", [&](uint64_t* b) { DES_interleaved<8>(b, schedule.forward); })) {
+        return false;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        GatherKeys gather_keys;
+        buildGatherKeys(gather_keys, schedule.forward);
+        if (!checkKernel("DES_gather8", [&](uint64_t* b) { DES_gather8(b, gather_keys); })) return false;
+    }
+
+    // the key search kernels flag the key of a known pair, among the 2^14 keys of its last two bytes
+    if (index % 16 == 0) {
+        SearchSpace space;
+        buildSearchSpace(space, key, 0xFFFFFFFFFFFF0000ULL);
+        SearchBlock block;
+        buildSearchBlock(block, x, encrypted);
+        uint64_t key_index = 0;
+        for (int b = 0; b < space.num_free; b++) {
+            key_index |= ((key >> (63 - space.free_bits[b])) & 0x01) << b;
+        }
+        for (const SearchKernel& search_kernel : search_kernels) {
+            if (selectBitsliceKernel(search_kernel.name) == nullptr) continue;
+            uint64_t first = key_index - key_index % search_kernel.keys;
+            SearchKeyPlanes planes;
+            planes.start(space, search_kernel.keys / 64, first);
+            uint64_t candidates[8];
+            search_kernel.run(planes, block, candidates);
+            uint64_t lane = key_index - first;
+            if (((candidates[lane / 64] >> (lane % 64)) & 0x01) == 0) {
+                report = string("search kernel ") + search_kernel.name + " missed key " + hex64(key) + " of pair " +
+                         hex64(x) + " " + hex64(encrypted);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Check the primitives on random samples.
+ */
+bool testPrimitives() {
+    uint64_t num_samples = 5 * num_cases;
+    cout << "Testing: primitives on " << num_samples << " random samples" << endl;
+    uint64_t failure = runParallel(num_samples, [](uint64_t index) {
+        string report;
+        return checkPrimitives(index, report);
+    });
+    if (failure < num_samples) {
+        string report;
+        checkPrimitives(failure, report);
+        cerr << "\033[31mMismatch in sample " << failure << " (--seed=" << seed << "): " << report << "\033[0m" << endl;
+        return false;
+    }
+    cout << "Passed: permutations, S-boxes, rounds, key schedules, DES(), interleaved, gather and search kernels"
+         << endl << endl;
+    return true;
+}
+
+// Random cases
+
+enum CaseMode {
+    // library
+    CASE_ECB_BYTES,    // DesContext::encrypt_bytes() and decrypt_bytes()
+    CASE_ECB_BLOCKS,   // processBlocks() on whole chunks, as the command line tool calls it
+    CASE_CTR,          // DesContext::ctr_bytes()
+    CASE_CBC,          // DesContext::cbc_encrypt_bytes() and cbc_decrypt_bytes(), one chain over the chunks
+    CASE_CBC_STREAMS,  // DesContext::cbc_encrypt_streams() and cbcDecryptBlocks(), a chain per chunk
+    CASE_MULTI_KEY,    // DesMultiKey, a key per block
+    NUM_LIBRARY_MODES,
+    // command line tool, a file per chunk in batch mode
+    CASE_TOOL_ECB = NUM_LIBRARY_MODES,
+    CASE_TOOL_CTR,
+    CASE_TOOL_CBC,
+    NUM_CASE_MODES
+};
+const char* case_mode_names[NUM_CASE_MODES] = {"ecb-bytes", "ecb-blocks", "ctr", "cbc", "cbc-streams", "multi-key",
+                                               "tool-ecb", "tool-ctr", "tool-cbc"};
+
+/**
+ * @brief A random case, everything needed to replay it.
+ */
+struct Case {
+    CaseMode mode;
+    string kernel;          // bitsliced kernel
+    bool decrypt;           // ignored by the tool, which encrypts then decrypts
+    int stages;             // 1 for DES, 3 for triple DES
+    uint64_t keys[3];
+    uint64_t iv;            // IV of the first chain (CBC) or first counter block (CTR)
+    uint64_t data_seed;     // seed of the data and, in multi-key mode, of the keys of the blocks
+    size_t size;            // bytes, a multiple of 8 in the ECB and CBC modes of the library
+    vector<size_t> splits;  // chunk boundaries, increasing, the API is called once per chunk
+    string io_path;         // tool only: read, stream:<size>, mmap, io-uring:<size> or batch
+    unsigned threads;       // tool only
+};
+
+/**
+ * @brief Result of a case: the first wrong byte, if any.
+ */
+struct CaseResult {
+    bool ok;
+    string stage;  // what was compared
+    size_t offset;
+    uint64_t input, expected, actual;  // the blocks at the offset
+};
+
+/**
+ * @brief Bytes of the data of a case, a prefix of the same stream whatever the size.
+ */
+vector<uint8_t> caseData(uint64_t data_seed, size_t size) {
+    vector<uint8_t> data(size);
+    uint64_t state = data_seed, value = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (i % 8 == 0) value = splitMix64(state);
+        data[i] = value >> (56 - 8 * (i % 8));
+    }
+    return data;
+}
+
+/**
+ * @brief Block at a byte offset, big-endian, padded with zeros past the end.
+ */
+uint64_t blockAt(const vector<uint8_t>& bytes, size_t offset) {
+    uint64_t block = 0;
+    for (size_t i = 0; i < 8; i++) {
+        block = (block << 8) | (offset + i < bytes.size() ? bytes[offset + i] : 0);
+    }
+    return block;
+}
+
+/**
+ * @brief Store a block at a byte offset, big-endian, truncated at the end.
+ */
+void setBlockAt(vector<uint8_t>& bytes, size_t offset, uint64_t block) {
+    for (size_t i = 0; i < 8 && offset + i < bytes.size(); i++) {
+        bytes[offset + i] = block >> (56 - 8 * i);
+    }
+}
+
+/**
+ * @brief Chunk boundaries of a case, from 0 to its size.
+ */
+vector<size_t> caseBounds(const Case& c) {
+    vector<size_t> bounds = {0};
+    for (size_t split : c.splits) {
+        if (split > bounds.back() && split < c.size) bounds.push_back(split);
+    }
+    bounds.push_back(c.size);
+    return bounds;
+}
+
+
+/**
+ * @brief Keys of the blocks of a multi-key case.
+ */
+vector<uint64_t> caseBlockKeys(uint64_t data_seed, size_t count) {
+    vector<uint64_t> keys(count);
+    uint64_t state = ~data_seed;
+    for (uint64_t& key : keys) key = splitMix64(state);
+    return keys;
+}
+
+/**
+ * @brief Oracle: DES() on the bit-serial key schedules, in three stages for triple DES (EDE).
+ */
+uint64_t oracleCipher(const KeySchedule* schedules, int stages, uint64_t block, bool decrypt) {
+    if (stages == 1) {
+        return decrypt ? DES<DES_DECRYPT>(block, schedules[0]) : DES<DES_ENCRYPT>(block, schedules[0]);
+    }
+    if (decrypt) {
+        return DES<DES_DECRYPT>(DES<DES_ENCRYPT>(DES<DES_DECRYPT>(block, schedules[2]), schedules[1]), schedules[0]);
+    }
+    return DES<DES_ENCRYPT>(DES<DES_DECRYPT>(DES<DES_ENCRYPT>(block, schedules[0]), schedules[1]), schedules[2]);
+}
+
+/**
+ * @brief Oracle of a stream in the ECB, CTR or CBC mode of a case, the last block may be partial in CTR mode.
+ *
+ * @param iv IV of the chain (CBC) or first counter block (CTR).
+ */
+void oracleStream(const Case& c, const KeySchedule* schedules, uint8_t* bytes, size_t size, bool decrypt,
+                  uint64_t iv) {
+    vector<uint8_t> stream(bytes, bytes + size);
+    uint64_t chain = iv;
+    for (size_t offset = 0; offset < size; offset += 8) {
+        uint64_t block = blockAt(stream, offset);
+        switch (c.mode) {
+            case CASE_CTR:
+            case CASE_TOOL_CTR:
+                setBlockAt(stream, offset, block ^ oracleCipher(schedules, c.stages, iv + offset / 8, false));
+                break;
+            case CASE_CBC:
+            case CASE_CBC_STREAMS:
+            case CASE_TOOL_CBC:
+                if (decrypt) {
+                    setBlockAt(stream, offset, oracleCipher(schedules, c.stages, block, true) ^ chain);
+                    chain = block;
+                } else {
+                    chain = oracleCipher(schedules, c.stages, block ^ chain, false);
+                    setBlockAt(stream, offset, chain);
+                }
+                break;
+            default:
+                setBlockAt(stream, offset, oracleCipher(schedules, c.stages, block, decrypt));
+                break;
+        }
+    }
+    memcpy(bytes, stream.data(), size);
+}
+
+/**
+ * @brief Expected output of a library case.
+ */
+vector<uint8_t> expectedLibraryOutput(const Case& c, const vector<uint8_t>& input) {
+    vector<uint8_t> output = input;
+    if (c.mode == CASE_MULTI_KEY) {
+        vector<uint64_t> keys = caseBlockKeys(c.data_seed, c.size / 8);
+        for (size_t i = 0; i < keys.size(); i++) {
+            KeySchedule schedule;
+            buildKeyScheduleSerial(schedule, keys[i]);
+            setBlockAt(output, 8 * i, oracleCipher(&schedule, 1, blockAt(input, 8 * i), c.decrypt));
+        }
+        return output;
+    }
+
+    KeySchedule schedules[3];
+    for (int s = 0; s < c.stages; s++) buildKeyScheduleSerial(schedules[s], c.keys[s]);
+    if (c.mode != CASE_CBC_STREAMS) {
+        // the chunks continue the same stream
+        oracleStream(c, schedules, output.data(), output.size(), c.decrypt, c.iv);
+        return output;
+    }
+    vector<size_t> bounds = caseBounds(c);
+    for (size_t k = 0; k + 1 < bounds.size(); k++) {
+        oracleStream(c, schedules, output.data() + bounds[k], bounds[k + 1] - bounds[k], c.decrypt, c.iv + k);
+    }
+    return output;
+}
+
+/**
+ * @brief Run a library case chunk by chunk.
+ */
+vector<uint8_t> runLibrary(const Case& c, const vector<uint8_t>& input) {
+    DesKey des_key = c.stages == 3 ? DesKey(c.keys[0], c.keys[1], c.keys[2]) : DesKey(c.keys[0]);
+    DesContext context(des_key, c.kernel.c_str());
+    KernelKeys kernel_keys;
+    prepareKernelKeys(kernel_keys, selectBitsliceKernel(c.kernel.c_str()),
+                      c.decrypt ? des_key.decryption_keys() : des_key.encryption_keys(), des_key.stages());
+
+    // in place on odd data seeds
+    vector<uint8_t> output = input;
+    const uint8_t* in = c.data_seed % 2 ? output.data() : input.data();
+    vector<size_t> bounds = caseBounds(c);
+    vector<uint64_t> blocks(c.size / 8);
+    memcpy(blocks.data(), input.data(), blocks.size() * 8);
+    vector<DesCbcStream> streams;
+    vector<uint64_t> block_keys = c.mode == CASE_MULTI_KEY ? caseBlockKeys(c.data_seed, c.size / 8) : vector<uint64_t>();
+    vector<uint64_t> values(c.size / 8);
+    for (size_t i = 0; i < values.size(); i++) values[i] = blockAt(input, 8 * i);
+
+    uint64_t chain = c.iv;
+    DesMultiKey multi_key(c.kernel.c_str());
+    for (size_t k = 0; k + 1 < bounds.size(); k++) {
+        size_t offset = bounds[k], size = bounds[k + 1] - bounds[k];
+        switch (c.mode) {
+            case CASE_ECB_BYTES:
+                if (c.decrypt) context.decrypt_bytes(in + offset, output.data() + offset, size);
+                else context.encrypt_bytes(in + offset, output.data() + offset, size);
+                break;
+            case CASE_ECB_BLOCKS:
+                processBlocks(blocks.data() + offset / 8, size / 8, kernel_keys);
+                break;
+            case CASE_CTR:
+                context.ctr_bytes(in + offset, output.data() + offset, size, c.iv + offset / 8);
+                break;
+            case CASE_CBC:
+                if (c.decrypt) context.cbc_decrypt_bytes(in + offset, output.data() + offset, size, chain);
+                else context.cbc_encrypt_bytes(in + offset, output.data() + offset, size, chain);
+                break;
+            case CASE_CBC_STREAMS:
+                if (c.decrypt) {
+                    uint64_t previous;
+                    storeBlock(&previous, c.iv + k);
+                    cbcDecryptBlocks(blocks.data() + offset / 8, size / 8, previous, kernel_keys);
+                } else {
+                    uint8_t* data = reinterpret_cast<uint8_t*>(blocks.data() + offset / 8);
+                    streams.push_back(DesCbcStream{data, size, c.iv + k});
+                }
+                break;
+            case CASE_MULTI_KEY:
+                if (c.decrypt) {
+                    multi_key.decrypt_blocks(block_keys.data() + offset / 8, values.data() + offset / 8,
+                                             values.data() + offset / 8, size / 8);
+                } else {
+                    multi_key.encrypt_blocks(block_keys.data() + offset / 8, values.data() + offset / 8,
+                                             values.data() + offset / 8, size / 8);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    // the chains of the streams are encrypted together
+    if (!streams.empty()) context.cbc_encrypt_streams(streams.data(), streams.size());
+    if (c.mode == CASE_ECB_BLOCKS || c.mode == CASE_CBC_STREAMS) memcpy(output.data(), blocks.data(), c.size);
+    if (c.mode == CASE_MULTI_KEY) {
+        for (size_t i = 0; i < values.size(); i++) setBlockAt(output, 8 * i, values[i]);
+    }
+    return output;
+}
+
+/**
+ * @brief Compare an output with the expected one.
+ */
+CaseResult compareOutput(const string& stage, const vector<uint8_t>& input, const vector<uint8_t>& expected,
+                         const vector<uint8_t>& actual) {
+    CaseResult result{true, stage, 0, 0, 0, 0};
+    size_t size = std::min(expected.size(), actual.size());
+    size_t offset = mismatch(expected.begin(), expected.begin() + size, actual.begin()).first - expected.begin();
+    if (offset == size && expected.size() == actual.size()) return result;
+
+    result.ok = false;
+    result.offset = offset;
+    result.input = blockAt(input, offset - offset % 8);
+    result.expected = blockAt(expected, offset - offset % 8);
+    result.actual = blockAt(actual, offset - offset % 8);
+    if (offset == size) result.stage += " (" + to_string(actual.size()) + " bytes instead of " +
+                                        to_string(expected.size()) + ")";
+    return result;
+}
+
+/**
+ * @brief Read a whole file, empty if it cannot be read.
+ */
+vector<uint8_t> readFile(const string& path) {
+    ifstream file(path, ios::binary);
+    return vector<uint8_t>(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+/**
+ * @brief Write a whole file.
+ */
+void writeFile(const string& path, const uint8_t* bytes, size_t size) {
+    ofstream(path, ios::binary | ios::trunc).write(reinterpret_cast<const char*>(bytes), size);
+}
+
+/**
+ * @brief Run the command line tool, its output discarded.
+ *
+ * @return true if it exits with 0.
+ */
+bool runTool(const vector<string>& args) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        vector<char*> argv;
+        argv.push_back(const_cast<char*>(cli_path.c_str()));
+        for (const string& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+        argv.push_back(nullptr);
+        execv(cli_path.c_str(), argv.data());
+        _exit(127);
+    }
+    int status = 0;
+    return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * @brief Run a case through the command line tool: encrypt, then decrypt what it encrypted.
+ *
+ * @param name Prefix of the files of the case, unique per running case.
+ */
+CaseResult runToolCase(const Case& c, const vector<uint8_t>& input, const string& name) {
+    bool batch = c.io_path == "batch";
+    vector<size_t> bounds = batch ? caseBounds(c) : vector<size_t>{0, c.size};
+    size_t num_files = bounds.size() - 1;
+
+    // key file, 16 bytes when K3 = K1
+    uint8_t key_bytes[24];
+    int key_size = c.stages == 1 ? 8 : c.keys[2] == c.keys[0] ? 16 : 24;
+    for (int i = 0; i < key_size; i++) key_bytes[i] = c.keys[i / 8] >> (56 - 8 * (i % 8));
+    writeFile(name + ".key", key_bytes, key_size);
+
+    // expected ciphertext of every file
+    KeySchedule schedules[3];
+    for (int s = 0; s < c.stages; s++) buildKeyScheduleSerial(schedules[s], c.keys[s]);
+    vector<uint8_t> plain, expected;
+    for (size_t k = 0; k < num_files; k++) {
+        vector<uint8_t> file(input.begin() + bounds[k], input.begin() + bounds[k + 1]);
+        writeFile(name + "." + to_string(k) + ".in", file.data(), file.size());
+        if (c.mode == CASE_TOOL_ECB) {
+            // the trailing bytes that do not fill a block are dropped
+            file.resize(file.size() / 8 * 8);
+        }
+        plain.insert(plain.end(), file.begin(), file.end());
+        if (c.mode == CASE_TOOL_CBC) {
+            // PKCS#7
+            size_t padding = 8 - file.size() % 8;
+            file.resize(file.size() + padding, static_cast<uint8_t>(padding));
+        }
+        oracleStream(c, schedules, file.data(), file.size(), false, c.iv);
+        expected.insert(expected.end(), file.begin(), file.end());
+    }
+
+    vector<string> options = {"--threads", to_string(c.threads), "--kernel=" + c.kernel};
+    if (c.mode != CASE_TOOL_ECB) options.push_back("--iv=" + hex64(c.iv));
+    if (!batch && c.io_path != "read") {
+        // stream:<size> is --stream=<size>
+        string option = "--" + c.io_path;
+        replace(option.begin(), option.end(), ':', '=');
+        options.push_back(option);
+    }
+    string suffix = c.mode == CASE_TOOL_CTR ? "-ctr" : c.mode == CASE_TOOL_CBC ? "-cbc" : "";
+
+    CaseResult result{true, "", 0, 0, 0, 0};
+    const char* stages[2][3] = {{"encrypt", "in", "enc"}, {"decrypt", "enc", "dec"}};
+    for (auto& stage : stages) {
+        vector<string> args;
+        if (batch) {
+            ofstream manifest(name + ".manifest");
+            for (size_t k = 0; k < num_files; k++) {
+                manifest << name << "." << k << "." << stage[1] << "\t" << name << "." << k << "." << stage[2] << "\n";
+            }
+            args = {"batch", stage[0] + suffix, name + ".manifest", name + ".key"};
+        } else {
+            args = {stage[0] + suffix, name + ".0." + stage[1], name + ".key", name + ".0." + stage[2]};
+        }
+        args.insert(args.end(), options.begin(), options.end());
+        bool ran = runTool(args);
+
+        vector<uint8_t> output;
+        for (size_t k = 0; k < num_files; k++) {
+            vector<uint8_t> file = readFile(name + "." + to_string(k) + "." + stage[2]);
+            output.insert(output.end(), file.begin(), file.end());
+        }
+        bool encrypting = &stage == &stages[0];
+        result = compareOutput(stage[0], encrypting ? input : expected, encrypting ? expected : plain, output);
+        if (!ran && result.ok) {
+            result.ok = false;
+            result.stage = string(stage[0]) + " (the tool failed)";
+        }
+        if (!result.ok) break;
+    }
+
+    for (size_t k = 0; k < num_files; k++) {
+        for (const char* extension : {".in", ".enc", ".dec"}) remove((name + "." + to_string(k) + extension).c_str());
+    }
+    remove((name + ".key").c_str());
+    remove((name + ".manifest").c_str());
+    return result;
+}
+
+/**
+ * @brief Run a case and compare its output with the oracle.
+ *
+ * @param name Prefix of the files of a tool case.
+ */
+CaseResult runCase(const Case& c, const string& name) {
+    vector<uint8_t> input = caseData(c.data_seed, c.size);
+    if (c.mode >= CASE_TOOL_ECB) return runToolCase(c, input, name);
+    return compareOutput(c.decrypt ? "decrypt" : "encrypt", input, expectedLibraryOutput(c, input),
+                         runLibrary(c, input));
+}
+
+/**
+ * @brief Generate a random case.
+ *
+ * @param index Number of the case, with the seed it sets the case.
+ * @param tool true for a case of the command line tool.
+ */
+Case generateCase(uint64_t index, bool tool) {
+    uint64_t state = seed * 0x9E3779B97F4A7C15ULL + index * 2 + tool;
+    splitMix64(state);
+
+    Case c;
+    c.mode = tool ? CaseMode(CASE_TOOL_ECB + randomBelow(state, 3)) : CaseMode(randomBelow(state, NUM_LIBRARY_MODES));
+    c.kernel = kernel_names[randomBelow(state, kernel_names.size())];
+    c.decrypt = !tool && randomBelow(state, 2);
+    c.stages = c.mode != CASE_MULTI_KEY && randomBelow(state, 4) == 0 ? 3 : 1;
+    for (uint64_t& key : c.keys) key = splitMix64(state);
+    if (c.stages == 3 && randomBelow(state, 4) == 0) c.keys[2] = c.keys[0];
+    c.iv = splitMix64(state);
+    c.data_seed = splitMix64(state);
+
+    // mostly around the widths of the kernels and the tiles of 512 blocks, sometimes several tiles
+    uint64_t range = randomBelow(state, 10);
+    size_t blocks = randomBelow(state, range < 4 ? 65 : range < 8 ? 1100 : tool ? 40000 : 5000);
+    c.size = 8 * blocks;
+    if (tool || c.mode == CASE_CTR) c.size += randomBelow(state, 8);
+
+    // chunk boundaries, on blocks
+    size_t num_splits = randomBelow(state, 4);
+    for (size_t i = 0; i < num_splits; i++) c.splits.push_back(8 * randomBelow(state, blocks + 1));
+    sort(c.splits.begin(), c.splits.end());
+
+    c.threads = 1;
+    c.io_path = "";
+    if (tool) {
+        const char* paths[] = {"read", "batch", "stream", "mmap", "io-uring"};
+        // CBC is only read whole, a CTR counter would be reused by the files of a batch
+        uint64_t path = c.mode == CASE_TOOL_CBC ? randomBelow(state, 2)
+                      : c.mode == CASE_TOOL_CTR ? 2 * randomBelow(state, 3) % 5
+                                                : randomBelow(state, 5);
+        c.io_path = paths[path];
+        if (c.io_path == "stream" || c.io_path == "io-uring") {
+            c.io_path += ":" + to_string(8 * (1 + randomBelow(state, 8192)));
+        }
+        c.threads = 1 + randomBelow(state, 4);
+    }
+    return c;
+}
+
+/**
+ * @brief The option that replays a case.
+ */
+string describeCase(const Case& c) {
+    ostringstream text;
+    text << "--replay=" << case_mode_names[c.mode] << "," << c.kernel << "," << (c.decrypt ? "decrypt" : "encrypt")
+         << "," << hex64(c.keys[0]);
+    if (c.stages == 3) text << ":" << hex64(c.keys[1]) << ":" << hex64(c.keys[2]);
+    text << "," << hex64(c.iv) << "," << hex64(c.data_seed) << "," << c.size << ",";
+    for (size_t i = 0; i < c.splits.size(); i++) text << (i ? ":" : "") << c.splits[i];
+    if (c.splits.empty()) text << "-";
+    if (c.mode >= CASE_TOOL_ECB) text << "," << c.io_path << "," << c.threads;
+    return text.str();
+}
+
+/**
+ * @brief Parse a case written by describeCase().
+ *
+ * @return false if it is not a case.
+ */
+bool parseCase(const string& text, Case& c) {
+    vector<string> fields;
+    stringstream stream(text);
+    string field;
+    while (getline(stream, field, ',')) fields.push_back(field);
+    if (fields.size() != 8 && fields.size() != 10) return false;
+
+    auto mode = find(begin(case_mode_names), end(case_mode_names), fields[0]);
+    if (mode == end(case_mode_names) || (fields.size() == 10) != (mode >= case_mode_names + CASE_TOOL_ECB)) return false;
+    c.mode = CaseMode(mode - case_mode_names);
+    c.kernel = fields[1];
+    c.decrypt = fields[2] == "decrypt";
+    vector<string> keys;
+    stringstream key_stream(fields[3]);
+    while (getline(key_stream, field, ':')) keys.push_back(field);
+    if (keys.size() != 1 && keys.size() != 3) return false;
+    c.stages = keys.size();
+    for (size_t s = 0; s < 3; s++) c.keys[s] = stoull(keys[s < keys.size() ? s : 0], nullptr, 16);
+    c.iv = stoull(fields[4], nullptr, 16);
+    c.data_seed = stoull(fields[5], nullptr, 16);
+    c.size = stoull(fields[6]);
+    c.splits.clear();
+    stringstream split_stream(fields[7]);
+    while (getline(split_stream, field, ':')) {
+        if (field != "-") c.splits.push_back(stoull(field));
+    }
+    c.io_path = fields.size() == 10 ? fields[8] : "";
+    c.threads = fields.size() == 10 ? stoul(fields[9]) : 1;
+    return find(kernel_names.begin(), kernel_names.end(), c.kernel) != kernel_names.end();
+}
+
+/**
+ * @brief Shrink a failing case while it still fails: fewer chunks, a single stage, less data, one thread.
+ */
+Case minimizeCase(Case c, const string& name) {
+    bool progress = true;
+    auto attempt = [&](const Case& candidate) {
+        if (runCase(candidate, name).ok) return false;
+        c = candidate;
+        progress = true;
+        return true;
+    };
+    while (progress) {
+        progress = false;
+        for (size_t i = 0; i < c.splits.size(); i++) {
+            Case candidate = c;
+            candidate.splits.erase(candidate.splits.begin() + i);
+            if (attempt(candidate)) break;
+        }
+        if (c.stages == 3) {
+            Case candidate = c;
+            candidate.stages = 1;
+            attempt(candidate);
+        }
+        if (c.threads > 1) {
+            Case candidate = c;
+            candidate.threads = 1;
+            attempt(candidate);
+        }
+
+        // up to the first wrong block, or half of the data
+        bool any_size = c.mode >= CASE_TOOL_ECB || c.mode == CASE_CTR;
+        CaseResult result = runCase(c, name);
+        for (size_t size : {result.offset - result.offset % 8 + 8, any_size ? c.size / 2 : c.size / 16 * 8}) {
+            if (size >= c.size || size == 0) continue;
+            Case candidate = c;
+            candidate.size = size;
+            candidate.splits.erase(remove_if(candidate.splits.begin(), candidate.splits.end(),
+                                             [size](size_t split) { return split >= size; }),
+                                   candidate.splits.end());
+            if (attempt(candidate)) break;
+        }
+    }
+    return c;
+}
+
+/**
+ * @brief Print a failing case, minimized.
+ */
+void reportCase(const string& title, const Case& c, const string& name) {
+    Case minimized = minimizeCase(c, name);
+    CaseResult result = runCase(minimized, name);
+    cerr << "\033[31mMismatch in " << title << " (--seed=" << seed << "): " << case_mode_names[c.mode] << " "
+         << (c.stages == 3 ? "3DES" : "DES") << ", kernel " << c.kernel << "\n"
+         << "  replay:    " << describeCase(c) << "\n"
+         << "  minimized: " << describeCase(minimized) << "\n"
+         << "  " << result.stage << ": first wrong byte at offset " << result.offset << " of " << minimized.size
+         << ", input block " << hex64(result.input) << ", expected " << hex64(result.expected) << ", got "
+         << hex64(result.actual) << "\033[0m" << endl;
+}
+
+/**
+ * @brief Run random cases in parallel.
+ *
+ * @param tool true for the cases of the command line tool.
+ */
+bool testCases(uint64_t count, bool tool) {
+    cout << "Testing: " << count << " random cases " << (tool ? "of the command line tool" : "of the library")
+         << endl;
+    uint64_t failure = runParallel(count, [tool](uint64_t index) {
+        return runCase(generateCase(index, tool), work_dir + "/" + to_string(index)).ok;
+    });
+    if (failure < count) {
+        reportCase("case " + to_string(failure), generateCase(failure, tool), work_dir + "/" + to_string(failure));
+        return false;
+    }
+    if (tool) {
+        cout << "Passed: ECB, CTR and CBC through the read, batch, stream, mmap and io-uring paths" << endl << endl;
+    } else {
+        cout << "Passed: ECB, CTR, CBC, batched CBC chains and multi-key on every kernel" << endl << endl;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+        string name = arg.substr(0, eq), value = eq == string::npos ? "" : arg.substr(eq + 1);
+        bool number = !value.empty() && value.find_first_not_of("0123456789") == string::npos;
+        if (name == "--seed" && number) seed = stoull(value);
+        else if (name == "--cases" && number) num_cases = stoull(value);
+        else if (name == "--cli-cases" && number) num_cli_cases = stoull(value);
+        else if (name == "--threads" && number) num_threads = stoul(value);
+        else if (name == "--cli" && !value.empty()) cli_path = value;
+        else if (name == "--replay" && !value.empty()) replay = value;
+        else {
+            cerr << "\033[31mUsage: test_kernels [--cases=<n>] [--seed=<n>] [--threads=<n>] [--cli=<path> "
+                    "[--cli-cases=<n>]] [--replay=<case>]\033[0m" << endl;
+            return 1;
+        }
+    }
+    if (num_threads == 0) num_threads = std::max(1u, thread::hardware_concurrency());
+
+    initPermutationTables();
+    for (const BitsliceKernel& kernel : bitslice_kernels) {
+        if (bitsliceKernelSupported(kernel)) kernel_names.push_back(kernel.name);
+    }
+    char dir_template[] = "/tmp/test_kernels.XXXXXX";
+    if (mkdtemp(dir_template) == nullptr) {
+        cerr << "\033[31mError: cannot create a temporary directory\033[0m" << endl;
+        return 1;
+    }
+    work_dir = dir_template;
+
+    bool ok;
+    if (!replay.empty()) {
+        Case c;
+        ok = parseCase(replay, c);
+        if (!ok) {
+            cerr << "\033[31mError: invalid case, or kernel not supported by this CPU: " << replay << "\033[0m" << endl;
+        } else if (c.mode >= CASE_TOOL_ECB && cli_path.empty()) {
+            cerr << "\033[31mError: --cli is needed to replay a case of the command line tool\033[0m" << endl;
+            ok = false;
+        } else if (!(ok = runCase(c, work_dir + "/replay").ok)) {
+            reportCase("replayed case", c, work_dir + "/replay");
+        } else {
+            cout << "\033[32mThe case passes.\033[0m" << endl;
+        }
+    } else {
+        ok = testKnownAnswers() && testPrimitives() && testCases(num_cases, false);
+        if (ok && !cli_path.empty()) {
+            ok = testCases(num_cli_cases, true);
+        } else if (ok) {
+            cout << "Skipped: the command line tool, pass --cli=<path> to test its I/O paths" << endl << endl;
+        }
+        if (ok) cout << "\033[32mAll differential tests passed successfully!\033[0m" << endl;
+    }
+    rmdir(work_dir.c_str());
+    return ok ? 0 : 1;
+}